@@ -7,7 +7,8 @@
  * fetch frames of data without blocking timeouts.
  * 
  * Key concepts:
- *   - fn_read() returns FN_ERR_NOT_READY when no data is available
+ *   - fn_read_view() returns FN_ERR_NOT_READY when no data is available
+ *   - Frames are processed where they sit in the library's buffer
  *   - No application-level timeouts needed for real-time polling
  *   - Server responds immediately with available data or NotReady
  * 
@@ -118,9 +119,12 @@ static unsigned long get_time_ms(void)
  * - Return immediately with what's available
  * - No timeouts on each read call
  * 
+ * The frame is not copied: *frame points into the library's response
+ * buffer and is valid until the next read.
+ * 
  * @param handle       Session handle
  * @param offset       Read offset (cumulative bytes read so far)
- * @param buf          Buffer to receive data
+ * @param frame        Output: address of the frame data
  * @param max_bytes    Maximum bytes to read
  * @param bytes_read   Output: bytes actually read
  * @param eof          Output: true if peer closed connection
@@ -128,7 +132,7 @@ static unsigned long get_time_ms(void)
  */
 static uint8_t read_frame(fn_handle_t handle,
                           uint32_t offset,
-                          uint8_t *buf,
+                          const uint8_t **frame,
                           uint16_t max_bytes,
                           uint16_t *bytes_read,
                           uint8_t *eof)
@@ -141,7 +145,7 @@ static uint8_t read_frame(fn_handle_t handle,
     *eof = 0;
     
     /* Try to read up to max_bytes at the current offset */
-    result = fn_read(handle, offset, buf, max_bytes, &n, &flags);
+    result = fn_read_view(handle, offset, max_bytes, frame, &n, &flags);
     
     if (result == FN_ERR_NOT_READY) {
         /* No data available yet - this is normal for non-blocking reads */
@@ -184,7 +188,7 @@ int main(void)
     uint8_t result;
     fn_handle_t handle;
     const char *url;
-    uint8_t frame_buf[MAX_FRAME_SIZE];
+    const uint8_t *frame;
     uint16_t bytes_read;
     uint8_t eof;
     unsigned long start_time, end_time;
@@ -259,13 +263,13 @@ int main(void)
     
     /* Main frame loop - demonstrate non-blocking reads */
     for (i = 0; i < FN_FRAME_COUNT; i++) {
-        result = read_frame(handle, total_bytes, frame_buf, MAX_FRAME_SIZE, &bytes_read, &eof);
+        result = read_frame(handle, total_bytes, &frame, MAX_FRAME_SIZE, &bytes_read, &eof);
         
         if (result == FN_OK) {
             if (bytes_read > 0) {
                 frames_received++;
                 total_bytes += bytes_read;
-                process_frame(frame_buf, bytes_read);
+                process_frame(frame, bytes_read);
             }
             if (eof) {
                 printf("Server closed connection.\n");
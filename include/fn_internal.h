@@ -22,6 +22,8 @@ extern "C" {
 #endif
 
 #include "fujinet-nio.h"
+#include "fn_protocol.h"
+#include "fn_platform.h"
 
 /* ============================================================================
  * SLIP Functions
@@ -32,11 +34,59 @@ extern "C" {
  */
 uint16_t fn_slip_encode(const uint8_t *input, uint16_t in_len, uint8_t *output);
 
+/**
+ * Escape data for a SLIP frame, without the END markers.
+ */
+uint16_t fn_slip_escape(const uint8_t *input, uint16_t in_len, uint8_t *output);
+
 /**
  * Decode SLIP-framed data.
  */
 uint16_t fn_slip_decode(const uint8_t *input, uint16_t in_len, uint8_t *output);
 
+/**
+ * Find the first END or ESCAPE byte.
+ * 
+ * Provided by platforms that define FN_HAVE_SLIP_SCAN.
+ * 
+ * @return Its index, or len if there is none
+ */
+uint16_t fn_slip_scan(const uint8_t *data, uint16_t len);
+
+/** Streaming decoder states */
+#define FN_SLIP_STATE_HUNT    0   /**< Waiting for an opening END */
+#define FN_SLIP_STATE_DATA    1   /**< Inside a frame */
+#define FN_SLIP_STATE_ESCAPE  2   /**< Inside a frame, after ESCAPE */
+
+/** Streaming decoder results */
+#define FN_SLIP_MORE          0   /**< Frame not complete yet */
+#define FN_SLIP_FRAME         1   /**< A complete frame has been decoded */
+#define FN_SLIP_OVERFLOW      2   /**< Frame does not fit the output buffer */
+
+/**
+ * Streaming SLIP decoder state.
+ */
+typedef struct {
+    uint8_t *out;       /**< Output buffer for the decoded frame */
+    uint16_t out_max;   /**< Output buffer size */
+    uint16_t len;       /**< Decoded bytes so far */
+    uint16_t expect;    /**< Frame length if known, 0 = wait for END */
+    uint8_t state;      /**< FN_SLIP_STATE_* */
+} fn_slip_decoder_t;
+
+/**
+ * Initialize a streaming SLIP decoder.
+ */
+void fn_slip_decoder_init(fn_slip_decoder_t *dec, uint8_t *out, uint16_t out_max);
+
+/**
+ * Feed raw bytes to a streaming SLIP decoder.
+ */
+uint8_t fn_slip_decoder_feed(fn_slip_decoder_t *dec,
+                             const uint8_t *input,
+                             uint16_t in_len,
+                             uint16_t *consumed);
+
 /* ============================================================================
  * Packet Building Functions
  * ============================================================================ */
@@ -57,6 +107,38 @@ uint16_t fn_build_read_packet(uint8_t *buffer,
                                uint32_t offset_val,
                                uint16_t max_bytes);
 
+/**
+ * One session's READ in a Read Multi request.
+ */
+typedef struct {
+    fn_handle_t handle;     /**< Session handle */
+    uint32_t offset;        /**< Read offset */
+    uint16_t max_bytes;     /**< Most data wanted */
+} fn_read_req_t;
+
+/**
+ * Build a Read Multi request packet.
+ */
+uint16_t fn_build_read_multi_packet(uint8_t *buffer,
+                                    const fn_read_req_t *reads,
+                                    uint8_t count);
+
+/**
+ * Build a Poll request packet for the handles in sessions.
+ */
+uint16_t fn_build_poll_packet(uint8_t *buffer,
+                              const fn_poll_t *sessions,
+                              uint8_t count);
+
+/**
+ * Build the head of a Write request packet (checksum includes the data).
+ */
+uint16_t fn_build_write_head(uint8_t *buffer,
+                             fn_handle_t handle,
+                             uint32_t offset_val,
+                             const fn_segment_t *data,
+                             uint8_t count);
+
 /**
  * Build a Write request packet.
  */
@@ -76,6 +158,65 @@ uint16_t fn_build_close_packet(uint8_t *buffer, fn_handle_t handle);
  */
 uint16_t fn_build_info_packet(uint8_t *buffer, fn_handle_t handle);
 
+/**
+ * Build a Frame Size request packet (hosted builds only).
+ */
+uint16_t fn_build_frame_size_packet(uint8_t *buffer, uint16_t max_frame);
+
+/* ============================================================================
+ * Wire Packet Writer
+ * ============================================================================ */
+
+/**
+ * Room kept at the start of a wire buffer for the opening END and the
+ * header, which is escaped last (its length and checksum cover the
+ * payload).
+ */
+#define FN_WIRE_HEADROOM  (1 + 2 * FN_HEADER_SIZE)
+
+/**
+ * SLIP-encoded packet being written.
+ * 
+ * The payload is escaped into the wire buffer and added to the checksum
+ * in the same pass, so it is read only once.
+ */
+typedef struct {
+    uint8_t *buf;       /**< Wire buffer */
+    uint16_t size;      /**< Wire buffer size */
+    uint16_t pos;       /**< Next free byte, 0 once the buffer has overflowed */
+    uint16_t raw;       /**< Payload bytes before escaping */
+    uint8_t chk;        /**< Checksum of the payload so far */
+} fn_wire_t;
+
+/**
+ * Start a packet in a wire buffer.
+ */
+void fn_wire_begin(fn_wire_t *w, uint8_t *buf, uint16_t size);
+
+/**
+ * Append payload bytes to a packet.
+ */
+void fn_wire_put(fn_wire_t *w, const uint8_t *data, uint16_t len);
+
+/**
+ * Finish a packet: write its header in front of the payload and close
+ * the frame.
+ * 
+ * @return Frame length (starting at buf + *start), or 0 if it did not fit
+ */
+uint16_t fn_wire_end(fn_wire_t *w, uint8_t device_id, uint8_t command, uint16_t *start);
+
+/**
+ * Build a Write request packet as a SLIP frame.
+ */
+uint16_t fn_build_write_wire(uint8_t *wire,
+                             uint16_t wire_size,
+                             uint16_t *start,
+                             fn_handle_t handle,
+                             uint32_t offset_val,
+                             const fn_segment_t *data,
+                             uint8_t count);
+
 /* ============================================================================
  * Response Parsing Functions
  * ============================================================================ */
@@ -98,6 +239,17 @@ uint8_t fn_parse_open_response(const uint8_t *response,
                                 uint8_t *flags,
                                 uint8_t *proto_flags);
 
+/**
+ * Parse a Read response without copying the data.
+ */
+uint8_t fn_parse_read_view(const uint8_t *response,
+                            uint16_t resp_len,
+                            fn_handle_t *handle,
+                            uint32_t *offset_echo,
+                            uint8_t *flags,
+                            const uint8_t **data,
+                            uint16_t *data_len);
+
 /**
  * Parse a Read response.
  */
@@ -110,6 +262,46 @@ uint8_t fn_parse_read_response(const uint8_t *response,
                                 uint16_t data_max,
                                 uint16_t *data_len);
 
+/**
+ * Parse the head of a Read Multi response: *count results follow at *pos.
+ */
+uint8_t fn_parse_read_multi_response(const uint8_t *response,
+                                     uint16_t resp_len,
+                                     uint8_t *count,
+                                     uint16_t *pos);
+
+/**
+ * Parse the Read Multi result at *pos, without copying its data, and
+ * move *pos to the next one.
+ */
+uint8_t fn_parse_read_multi_entry(const uint8_t *response,
+                                  uint16_t resp_len,
+                                  uint16_t *pos,
+                                  fn_handle_t *handle,
+                                  uint8_t *status,
+                                  uint8_t *flags,
+                                  uint32_t *offset_echo,
+                                  const uint8_t **data,
+                                  uint16_t *data_len);
+
+/**
+ * Parse the head of a Poll response: *count results follow at *pos.
+ */
+uint8_t fn_parse_poll_response(const uint8_t *response,
+                               uint16_t resp_len,
+                               uint8_t *count,
+                               uint16_t *pos);
+
+/**
+ * Parse the Poll result at *pos and move *pos to the next one.
+ */
+uint8_t fn_parse_poll_entry(const uint8_t *response,
+                            uint16_t resp_len,
+                            uint16_t *pos,
+                            fn_handle_t *handle,
+                            uint8_t *flags,
+                            uint16_t *available);
+
 /**
  * Parse an Info response.
  */
@@ -120,6 +312,141 @@ uint8_t fn_parse_info_response(const uint8_t *response,
                                 uint32_t *content_length,
                                 uint8_t *flags);
 
+/**
+ * Parse a Frame Size response (hosted builds only).
+ */
+uint8_t fn_parse_frame_size_response(const uint8_t *response,
+                                     uint16_t resp_len,
+                                     uint16_t *max_frame);
+
+/* ============================================================================
+ * Shared Library State (fn_network.c)
+ * ============================================================================ */
+
+/**
+ * Default packet arena size (fn_arena.c), used by fn_init(). Requests
+ * are built in its first FN_MAX_FRAME_SIZE bytes, responses received in
+ * the rest.
+ */
+#define FN_ARENA_SIZE  (2 * FN_MAX_FRAME_SIZE)
+
+/**
+ * Session table slots: a power of two, at least FN_MAX_SESSIONS. The
+ * table is hashed on the handle; above 8 sessions it is kept at most
+ * half full so lookups stay short.
+ */
+#ifndef FN_SESSION_TABLE_SIZE
+#if FN_MAX_SESSIONS <= 2
+#define FN_SESSION_TABLE_SIZE  2
+#elif FN_MAX_SESSIONS <= 4
+#define FN_SESSION_TABLE_SIZE  4
+#elif FN_MAX_SESSIONS <= 8
+#define FN_SESSION_TABLE_SIZE  8
+#elif FN_MAX_SESSIONS <= 16
+#define FN_SESSION_TABLE_SIZE  32
+#elif FN_MAX_SESSIONS <= 32
+#define FN_SESSION_TABLE_SIZE  64
+#elif FN_MAX_SESSIONS <= 64
+#define FN_SESSION_TABLE_SIZE  128
+#elif FN_MAX_SESSIONS <= 128
+#define FN_SESSION_TABLE_SIZE  256
+#elif FN_MAX_SESSIONS <= 256
+#define FN_SESSION_TABLE_SIZE  512
+#elif FN_MAX_SESSIONS <= 512
+#define FN_SESSION_TABLE_SIZE  1024
+#elif FN_MAX_SESSIONS <= 1024
+#define FN_SESSION_TABLE_SIZE  2048
+#elif FN_MAX_SESSIONS <= 2048
+#define FN_SESSION_TABLE_SIZE  4096
+#else
+#error "FN_MAX_SESSIONS is larger than 2048"
+#endif
+#endif
+
+#if (FN_SESSION_TABLE_SIZE & (FN_SESSION_TABLE_SIZE - 1)) != 0 || FN_SESSION_TABLE_SIZE < FN_MAX_SESSIONS
+#error "FN_SESSION_TABLE_SIZE must be a power of two, at least FN_MAX_SESSIONS"
+#endif
+
+/* fn_read_multi() keeps one bit per entry of a batch in a uint8_t */
+#if FN_MAX_READ_MULTI > 8
+#error "FN_MAX_READ_MULTI must be at most 8"
+#endif
+
+/** Request and response packet buffers (set by fn_init_ex()) */
+extern uint8_t *fn_req_buf;
+extern uint8_t *fn_resp_buf;
+
+/**
+ * Room for a wire frame, which is built at fn_req_buf and runs on into
+ * the response buffer when that follows it in memory.
+ */
+extern uint16_t fn_wire_size;
+
+/** Largest packet the link carries (agreed by fn_init_ex()) */
+extern uint16_t fn_max_frame;
+
+/** Set while an asynchronous operation owns the link */
+extern uint8_t fn_async_busy;
+
+/**
+ * Set while the library exchanges a request whose response it can give
+ * up on early: one it will send again if the response is lost or
+ * damaged, or the frame size probe. Only then may a transport wait for
+ * an adaptive deadline rather than FN_TRANSPORT_TIMEOUT.
+ */
+extern uint8_t fn_exchange_adaptive;
+
+/**
+ * Set when the last response arrived damaged: a bad checksum or length,
+ * or broken framing. Cleared before each retried exchange.
+ */
+extern uint8_t fn_frame_damaged;
+
+/**
+ * Find an open session by handle.
+ * 
+ * @return Session, or NULL if the handle is not tracked
+ */
+fn_session_t *fn_session_find(fn_handle_t handle);
+
+/**
+ * Exchange a packet through the active transport.
+ * 
+ * @return FN_ERR_BUSY while an asynchronous operation owns the link,
+ *         otherwise as fn_transport_exchange()
+ */
+uint8_t fn_exchange(const uint8_t *request,
+                    uint16_t req_len,
+                    uint8_t *response,
+                    uint16_t resp_max,
+                    uint16_t *resp_len);
+
+/**
+ * Exchange an already SLIP-encoded packet through the active transport.
+ * 
+ * Only for transports where FN_TRANSPORT_HAS_WIRE() is true.
+ * 
+ * @return As fn_exchange()
+ */
+uint8_t fn_exchange_wire(const uint8_t *wire,
+                         uint16_t wire_len,
+                         uint8_t *response,
+                         uint16_t resp_max,
+                         uint16_t *resp_len);
+
+/**
+ * Exchange a packet given as segments through the active transport.
+ * 
+ * Only for transports where FN_TRANSPORT_HAS_SG() is true.
+ * 
+ * @return As fn_exchange()
+ */
+uint8_t fn_exchange_sg(const fn_segment_t *segs,
+                       uint8_t count,
+                       uint8_t *response,
+                       uint16_t resp_max,
+                       uint16_t *resp_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,12 @@
  * communication with the FujiNet device. The platform layer handles
  * the physical transport (SIO, SmartPort, Drivewire, etc.).
  * 
+ * The library calls the transport either directly (the default on 8-bit
+ * compilers, so there is no indirect call overhead) or through a
+ * registered operations table, which lets one binary switch between
+ * transports at runtime. Define FN_TRANSPORT_DIRECT or FN_TRANSPORT_VTABLE
+ * to override the default.
+ * 
  * @version 1.0.0
  */
 
@@ -20,6 +26,7 @@ extern "C" {
     #include <cmoc.h>
 #else
     #include <stdint.h>
+    #include <stddef.h>
 #endif
 
 /* ============================================================================
@@ -67,6 +74,28 @@ uint8_t fn_transport_exchange(const uint8_t *request,
                                uint16_t resp_max,
                                uint16_t *resp_len);
 
+/**
+ * @brief Send an already SLIP-encoded request and receive a response.
+ * 
+ * As fn_transport_exchange(), but the request is a complete SLIP frame
+ * (END, escaped packet, END) built by the library's wire writer, so the
+ * transport sends it as it is. Optional: only platforms that define
+ * FN_TRANSPORT_DIRECT_WIRE provide it. The frame may run on into the
+ * response buffer: it must be sent before the response is stored.
+ * 
+ * @param wire         SLIP frame
+ * @param wire_len     Length of the frame
+ * @param response     Buffer to receive response packet
+ * @param resp_max     Maximum response buffer size
+ * @param resp_len     Pointer to receive actual response length
+ * @return FN_OK on success, error code on failure
+ */
+uint8_t fn_transport_exchange_wire(const uint8_t *wire,
+                                    uint16_t wire_len,
+                                    uint8_t *response,
+                                    uint16_t resp_max,
+                                    uint16_t *resp_len);
+
 /**
  * @brief Get the platform name string.
  * 
@@ -74,6 +103,139 @@ uint8_t fn_transport_exchange(const uint8_t *request,
  */
 const char *fn_platform_name(void);
 
+/* ============================================================================
+ * Transport Operations Table
+ * ============================================================================ */
+
+/** Link may corrupt data - response checksums must be verified */
+#define FN_TRANSPORT_CAP_CHECKSUM   0x01
+
+/** Link accepts several requests before the first response (send/recv) */
+#define FN_TRANSPORT_CAP_PIPELINE   0x02
+
+/** Link can wait for a response without blocking (send/poll) */
+#define FN_TRANSPORT_CAP_ASYNC      0x04
+
+/**
+ * One piece of a request packet, for transports that gather (exchange_sg).
+ */
+typedef struct {
+    const uint8_t *data;    /**< Bytes of the packet (not SLIP-encoded) */
+    uint16_t len;           /**< Number of bytes */
+} fn_segment_t;
+
+/**
+ * Transport operations and capabilities.
+ * 
+ * A transport is a set of functions with the same contract as
+ * fn_transport_init(), fn_transport_ready() and fn_transport_exchange(),
+ * plus a description of what the link can carry.
+ * 
+ * Transports with FN_TRANSPORT_CAP_PIPELINE also provide send and recv,
+ * which split an exchange in two: send queues one request, recv returns
+ * the next response in the order the requests were sent. Any bytes read
+ * past the end of a response must be kept for the next recv.
+ * 
+ * Transports with FN_TRANSPORT_CAP_ASYNC also provide send and poll.
+ * poll is recv without blocking: it returns FN_ERR_NOT_READY until the
+ * response is complete, keeping its progress between calls, and applies
+ * the receive timeout itself.
+ * 
+ * A max_frame above FN_MAX_PACKET_SIZE makes fn_init() ask the device for
+ * larger frames. The size agreed is passed to set_max_frame (if not NULL)
+ * before any frame that large is sent, so the transport can size its
+ * buffers; an error there keeps the default frame.
+ * 
+ * Transports that provide exchange_wire are handed some requests (large
+ * writes) already SLIP-encoded, as for fn_transport_exchange_wire(). The
+ * frame may run on into the response buffer, so it must be sent before
+ * any of the response is stored.
+ * Builds where no transport can take them leave FN_TRANSPORT_EXCHANGE_WIRE
+ * undefined, and the library leaves out its wire writer.
+ * 
+ * Transports that provide exchange_sg are handed some requests (writes)
+ * as a list of segments which together make the packet: the header in the
+ * library's buffer, then the data where the caller keeps it. The checksum
+ * already covers every segment; the transport sends them as one frame.
+ * 
+ * set_buffer (if not NULL) is called before init with the transport
+ * buffer given to fn_init_ex() (NULL from fn_init()). A transport may
+ * keep its buffers there instead of allocating them, when they fit.
+ * 
+ * discard (if not NULL) drops unread input, such as a late response to a
+ * timed-out request. exchange does this itself; the library calls discard
+ * before the first send of a pipelined read or an asynchronous request.
+ */
+typedef struct {
+    const char *name;       /**< Short name (e.g., "serial", "socket") */
+    uint16_t max_frame;     /**< Largest FujiBus packet the link carries */
+    uint8_t caps;           /**< Capability flags (FN_TRANSPORT_CAP_*) */
+    uint8_t (*init)(void);
+    uint8_t (*ready)(void);
+    uint8_t (*exchange)(const uint8_t *request,
+                        uint16_t req_len,
+                        uint8_t *response,
+                        uint16_t resp_max,
+                        uint16_t *resp_len);
+    void (*close)(void);    /**< Optional, may be NULL */
+    uint8_t (*send)(const uint8_t *request,
+                    uint16_t req_len);      /**< FN_TRANSPORT_CAP_PIPELINE only */
+    uint8_t (*recv)(uint8_t *response,
+                    uint16_t resp_max,
+                    uint16_t *resp_len);    /**< FN_TRANSPORT_CAP_PIPELINE only */
+    uint8_t (*poll)(uint8_t *response,
+                    uint16_t resp_max,
+                    uint16_t *resp_len);    /**< FN_TRANSPORT_CAP_ASYNC only */
+    uint8_t (*set_max_frame)(uint16_t max_frame);   /**< Optional, may be NULL */
+    uint8_t (*exchange_wire)(const uint8_t *wire,
+                             uint16_t wire_len,
+                             uint8_t *response,
+                             uint16_t resp_max,
+                             uint16_t *resp_len);   /**< Optional, may be NULL */
+    uint8_t (*exchange_sg)(const fn_segment_t *segs,
+                           uint8_t count,
+                           uint8_t *response,
+                           uint16_t resp_max,
+                           uint16_t *resp_len);     /**< Optional, may be NULL */
+    uint8_t (*set_buffer)(uint8_t *buf, size_t size);  /**< Optional, may be NULL */
+    void (*discard)(void);  /**< Optional, may be NULL */
+} fn_transport_ops_t;
+
+/**
+ * @brief Select the transport used by the library.
+ * 
+ * Must be called before fn_init(). If no transport is registered,
+ * fn_init() uses fn_transport_default(). Only available when the
+ * library is built with the operations table (not FN_TRANSPORT_DIRECT).
+ * 
+ * @param ops    Transport operations (must stay valid while in use)
+ * @return FN_OK on success, FN_ERR_INVALID if ops is incomplete,
+ *         FN_ERR_BUSY if the library is already initialized
+ */
+uint8_t fn_transport_register(const fn_transport_ops_t *ops);
+
+/**
+ * @brief Get the platform's default transport.
+ * 
+ * Platforms with a single transport get a table built from the
+ * direct-call functions above. Platforms with several (Linux) define
+ * FN_HAVE_TRANSPORT_DEFAULT and choose one at runtime.
+ * 
+ * @return Transport operations table
+ */
+const fn_transport_ops_t *fn_transport_default(void);
+
+#if defined(__linux__) && !defined(__CC65__)
+/** Linux: termios serial port or PTY named by FN_PORT */
+extern const fn_transport_ops_t fn_transport_serial;
+
+/** Linux: "unix:/path" or "tcp://host:port" socket named by FN_PORT */
+extern const fn_transport_ops_t fn_transport_socket;
+
+/** Linux: release the active link (serial settings are restored) */
+void fn_transport_close(void);
+#endif
+
 /* ============================================================================
  * Platform-Specific Configuration
  * ============================================================================ */
@@ -82,7 +244,11 @@ const char *fn_platform_name(void);
 
 /** Default timeout for transport operations (milliseconds) */
 #ifndef FN_TRANSPORT_TIMEOUT
-#define FN_TRANSPORT_TIMEOUT  5000
+    #if defined(__linux__) && !defined(__CC65__)
+        #define FN_TRANSPORT_TIMEOUT  2000
+    #else
+        #define FN_TRANSPORT_TIMEOUT  5000
+    #endif
 #endif
 
 /** Maximum retries for transport operations */
@@ -126,11 +292,127 @@ const char *fn_platform_name(void);
     #define FN_PLATFORM_NAME     "msdos"
 #endif
 
+/* GCC on Linux (native testing) */
+#if defined(__linux__) && !defined(__CC65__)
+    #define FN_PLATFORM_LINUX    1
+    #define FN_PLATFORM_NAME     "linux"
+    #define FN_HAVE_TRANSPORT_DEFAULT 1
+    #define FN_HAVE_FAST_CHECKSUM     1
+    #define FN_HAVE_SLIP_SCAN         1
+#endif
+
 /* Default if not detected */
 #ifndef FN_PLATFORM_NAME
     #define FN_PLATFORM_NAME     "unknown"
 #endif
 
+/**
+ * Free-running millisecond clock, wrapping at 16 bits, for delays the
+ * library times itself (write buffer flushes). Platforms without a clock
+ * read 0, so those delays never run out.
+ */
+#if defined(FN_PLATFORM_LINUX)
+    uint16_t fn_platform_ms(void);
+    #define FN_PLATFORM_MS()    fn_platform_ms()
+#elif defined(FN_PLATFORM_ATARI)
+    /* RTCLOK counts frames (20 ms PAL, 16.7 ms NTSC): 16 ms is close enough */
+    #define FN_PLATFORM_MS()    ((uint16_t)((*(volatile uint8_t *)0x14 | \
+                                             (*(volatile uint8_t *)0x13 << 8)) << 4))
+#else
+    #define FN_PLATFORM_MS()    0
+#endif
+
+/* ============================================================================
+ * Transport Dispatch
+ * ============================================================================ */
+
+/* 8-bit compilers call the platform transport directly unless told otherwise */
+#if !defined(FN_TRANSPORT_DIRECT) && !defined(FN_TRANSPORT_VTABLE)
+    #if defined(__CC65__) || defined(_CMOC_VERSION_) || defined(__WATCOMC__)
+        #define FN_TRANSPORT_DIRECT  1
+    #endif
+#endif
+
+/* Capabilities of the direct-call transport (platforms may override) */
+#ifdef FN_PLATFORM_ATARI
+    #ifndef FN_TRANSPORT_DIRECT_MAX_FRAME
+    #define FN_TRANSPORT_DIRECT_MAX_FRAME  512
+    #endif
+#endif
+
+#ifndef FN_TRANSPORT_DIRECT_MAX_FRAME
+#define FN_TRANSPORT_DIRECT_MAX_FRAME  FN_MAX_PACKET_SIZE
+#endif
+
+#ifndef FN_TRANSPORT_DIRECT_CAPS
+#define FN_TRANSPORT_DIRECT_CAPS       FN_TRANSPORT_CAP_CHECKSUM
+#endif
+
+/**
+ * Frame size the default packet arena (fn_init()) is sized for. Hosted
+ * builds allow the full 16-bit length, and negotiate frames up to what
+ * the buffers hold. 8-bit targets keep the default frame, or the
+ * direct-call transport's frame when that is smaller (the link never
+ * carries more).
+ */
+#ifndef FN_MAX_FRAME_SIZE
+    #if defined(FN_PLATFORM_LINUX)
+        #define FN_MAX_FRAME_SIZE    FN_FRAME_SIZE_LIMIT
+    #elif defined(FN_TRANSPORT_DIRECT)
+        #define FN_MAX_FRAME_SIZE    FN_TRANSPORT_DIRECT_MAX_FRAME
+    #else
+        #define FN_MAX_FRAME_SIZE    FN_MAX_PACKET_SIZE
+    #endif
+#endif
+
+#ifdef FN_TRANSPORT_DIRECT
+
+#define FN_TRANSPORT_INIT()         fn_transport_init()
+#define FN_TRANSPORT_READY()        fn_transport_ready()
+#define FN_TRANSPORT_EXCHANGE(req, req_len, resp, resp_max, resp_len) \
+        fn_transport_exchange(req, req_len, resp, resp_max, resp_len)
+#define FN_TRANSPORT_MAX_FRAME()    FN_TRANSPORT_DIRECT_MAX_FRAME
+#define FN_TRANSPORT_CAPS()         FN_TRANSPORT_DIRECT_CAPS
+#define FN_TRANSPORT_SET_MAX_FRAME(max_frame)   FN_OK
+#define FN_TRANSPORT_SET_BUFFER(buf, size)      FN_OK
+#ifdef FN_TRANSPORT_DIRECT_WIRE
+#define FN_TRANSPORT_HAS_WIRE()     1
+#define FN_TRANSPORT_EXCHANGE_WIRE(wire, wire_len, resp, resp_max, resp_len) \
+        fn_transport_exchange_wire(wire, wire_len, resp, resp_max, resp_len)
+#endif
+
+#else
+
+/** Active transport (set by fn_transport_register() or fn_init()) */
+extern const fn_transport_ops_t *fn_transport;
+
+#define FN_TRANSPORT_INIT()         (fn_transport->init())
+#define FN_TRANSPORT_READY()        (fn_transport->ready())
+#define FN_TRANSPORT_EXCHANGE(req, req_len, resp, resp_max, resp_len) \
+        (fn_transport->exchange(req, req_len, resp, resp_max, resp_len))
+#define FN_TRANSPORT_MAX_FRAME()    (fn_transport->max_frame)
+#define FN_TRANSPORT_CAPS()         (fn_transport->caps)
+#define FN_TRANSPORT_SEND(req, req_len) \
+        (fn_transport->send(req, req_len))
+#define FN_TRANSPORT_RECV(resp, resp_max, resp_len) \
+        (fn_transport->recv(resp, resp_max, resp_len))
+#define FN_TRANSPORT_POLL(resp, resp_max, resp_len) \
+        (fn_transport->poll(resp, resp_max, resp_len))
+#define FN_TRANSPORT_SET_MAX_FRAME(max_frame) \
+        (fn_transport->set_max_frame != NULL ? fn_transport->set_max_frame(max_frame) : FN_OK)
+#define FN_TRANSPORT_SET_BUFFER(buf, size) \
+        (fn_transport->set_buffer != NULL ? fn_transport->set_buffer(buf, size) : FN_OK)
+#define FN_TRANSPORT_HAS_WIRE()     (fn_transport->exchange_wire != NULL)
+#define FN_TRANSPORT_EXCHANGE_WIRE(wire, wire_len, resp, resp_max, resp_len) \
+        (fn_transport->exchange_wire(wire, wire_len, resp, resp_max, resp_len))
+#define FN_TRANSPORT_HAS_SG()       (fn_transport->exchange_sg != NULL)
+#define FN_TRANSPORT_EXCHANGE_SG(segs, count, resp, resp_max, resp_len) \
+        (fn_transport->exchange_sg(segs, count, resp, resp_max, resp_len))
+#define FN_TRANSPORT_DISCARD() \
+        do { if (fn_transport->discard != NULL) fn_transport->discard(); } while (0)
+
+#endif /* FN_TRANSPORT_DIRECT */
+
 #ifdef __cplusplus
 }
 #endif
@@ -78,6 +78,19 @@ extern "C" {
 /** Get session information */
 #define FN_CMD_INFO    0x05
 
+/** Read from several sessions in one exchange */
+#define FN_CMD_READ_MULTI 0x06
+
+/** Get the state of several sessions in one exchange */
+#define FN_CMD_POLL    0x07
+
+/* ============================================================================
+ * Fuji Device Commands
+ * ============================================================================ */
+
+/** Agree on the largest frame for the link (see fn_init()) */
+#define FN_CMD_FUJI_FRAME_SIZE   0xF0
+
 /* ============================================================================
  * Clock Device Commands
  * ============================================================================ */
@@ -191,9 +204,12 @@ extern "C" {
  *   u8[] payload      - Payload data
  */
 
-/** Maximum FujiBus packet size */
+/** Default FujiBus packet size; every device accepts frames this large */
 #define FN_MAX_PACKET_SIZE   1024
 
+/** Largest packet the 16-bit length field can describe */
+#define FN_FRAME_SIZE_LIMIT  65535
+
 /** Maximum parameters per packet */
 #define FN_MAX_PARAMS        4
 
@@ -206,6 +222,27 @@ extern "C" {
 /** Legacy name for compatibility */
 #define FN_PACKET_HEADER_SIZE FN_HEADER_SIZE
 
+/** Read response bytes ahead of the data: header + params + read fields */
+#define FN_READ_RESP_OVERHEAD  (FN_HEADER_SIZE + FN_PARAM_DESC_SIZE + 12)
+
+/** Write request bytes ahead of the data: header + write fields */
+#define FN_WRITE_REQ_OVERHEAD  (FN_HEADER_SIZE + 9)
+
+/** Read-multi response bytes ahead of the results: header + params + fields */
+#define FN_READ_MULTI_RESP_OVERHEAD  (FN_HEADER_SIZE + FN_PARAM_DESC_SIZE + 5)
+
+/** Read-multi response bytes ahead of each result's data */
+#define FN_READ_MULTI_ENTRY_SIZE     10
+
+/** Poll response bytes ahead of the results: header + params + fields */
+#define FN_POLL_RESP_OVERHEAD        (FN_HEADER_SIZE + FN_PARAM_DESC_SIZE + 5)
+
+/** Poll response bytes for each session */
+#define FN_POLL_ENTRY_SIZE           5
+
+/** Most sessions in one Poll request (the count is one byte) */
+#define FN_POLL_MAX_COUNT            255
+
 /* ============================================================================
  * Parameter Descriptor Format
  * ============================================================================ */
@@ -234,10 +271,21 @@ typedef struct {
     uint8_t active;        /**< 1 if session is active */
     uint8_t proto_flags;   /**< Protocol capability flags (FN_PROTO_FLAG_*) */
     uint8_t needs_body;    /**< 1 if body write required */
-    uint8_t reserved;      /**< Padding */
+    uint8_t wb_error;      /**< Why the last flush failed (no more automatic flushes), or FN_OK */
     fn_handle_t handle;    /**< Device-assigned handle */
     uint32_t write_offset; /**< Current write offset */
     uint32_t read_offset;  /**< Current read offset */
+#if FN_READ_AHEAD_BUFFERS > 0
+    uint8_t *ra_buf;       /**< Read-ahead buffer, or NULL */
+    uint32_t ra_offset;    /**< Offset of the first byte in ra_buf */
+    uint16_t ra_len;       /**< Bytes in ra_buf */
+    uint8_t ra_flags;      /**< Read flags that came with them (FN_READ_EOF) */
+#endif
+#if FN_WRITE_BUFFERS > 0
+    uint8_t *wb_buf;       /**< Write buffer, or NULL */
+    uint16_t wb_len;       /**< Bytes in wb_buf (already counted in write_offset) */
+    uint16_t wb_time;      /**< When the first of them was buffered (FN_PLATFORM_MS()) */
+#endif
 } fn_session_t;
 
 /* ============================================================================
@@ -253,6 +301,16 @@ typedef struct {
  */
 uint8_t fn_calc_checksum(const uint8_t *data, uint16_t len);
 
+/**
+ * Add bytes to a running FujiBus checksum.
+ * 
+ * @param chk       Checksum so far (0 to start)
+ * @param data      Data to add
+ * @param len       Length of data
+ * @return Updated checksum
+ */
+uint8_t fn_checksum_update(uint8_t chk, const uint8_t *data, uint16_t len);
+
 /**
  * Build a FujiBus packet header.
  * 
@@ -43,12 +43,88 @@ extern "C" {
 /** Maximum URL length supported */
 #define FN_MAX_URL_LEN      256
 
-/** Maximum concurrent network sessions */
-#define FN_MAX_SESSIONS     4
+/**
+ * Maximum concurrent network sessions (may be set at build time, up to
+ * 2048; 256 by default on hosted builds)
+ */
+#ifndef FN_MAX_SESSIONS
+    #if defined(__linux__) && !defined(__CC65__)
+        #define FN_MAX_SESSIONS     256
+    #else
+        #define FN_MAX_SESSIONS     4
+    #endif
+#endif
 
-/** Maximum read/write chunk size */
+/** Read/write chunk size every link supports (see fn_max_chunk_size()) */
 #define FN_MAX_CHUNK_SIZE   512
 
+/** Maximum READ requests fn_read_pipelined() keeps in flight */
+#define FN_MAX_PIPELINE_DEPTH 8
+
+/** Maximum buffers fn_writev() gathers into one WRITE request */
+#define FN_MAX_WRITEV_SEGMENTS 8
+
+/** Maximum sessions fn_read_multi() reads in one exchange */
+#define FN_MAX_READ_MULTI   8
+
+/** Maximum asynchronous operations submitted but not yet harvested */
+#define FN_MAX_ASYNC_OPS    4
+
+/** Smallest request or response buffer fn_init_ex() accepts */
+#define FN_MIN_BUFFER_SIZE  512
+
+/**
+ * Size of one read-ahead buffer (FN_OPEN_READ_AHEAD): the most a session
+ * fetches ahead of small reads
+ */
+#ifndef FN_READ_AHEAD_SIZE
+    #if defined(__linux__) && !defined(__CC65__)
+        #define FN_READ_AHEAD_SIZE  4096
+    #else
+        #define FN_READ_AHEAD_SIZE  FN_MAX_CHUNK_SIZE
+    #endif
+#endif
+
+/**
+ * Size of one write buffer (FN_OPEN_WRITE_BUFFER): the most small writes
+ * a session coalesces into one WRITE request
+ */
+#ifndef FN_WRITE_BUFFER_SIZE
+    #if defined(__linux__) && !defined(__CC65__)
+        #define FN_WRITE_BUFFER_SIZE 4096
+    #else
+        #define FN_WRITE_BUFFER_SIZE FN_MAX_CHUNK_SIZE
+    #endif
+#endif
+
+/**
+ * Read-ahead buffers in fn_init()'s default pool: 8 on Linux, enough
+ * for 8 sessions at a time. 0 (the default on 8-bit targets) builds the
+ * library without read-ahead, so sessions don't carry its state and
+ * FN_OPEN_READ_AHEAD is ignored.
+ */
+#ifndef FN_READ_AHEAD_BUFFERS
+    #if defined(__linux__) && !defined(__CC65__)
+        #define FN_READ_AHEAD_BUFFERS 8
+    #else
+        #define FN_READ_AHEAD_BUFFERS 0
+    #endif
+#endif
+
+/** Write buffers in fn_init()'s default pool, 8 on Linux as for read-ahead */
+#ifndef FN_WRITE_BUFFERS
+    #if defined(__linux__) && !defined(__CC65__)
+        #define FN_WRITE_BUFFERS    8
+    #else
+        #define FN_WRITE_BUFFERS    0
+    #endif
+#endif
+
+/** Default time buffered writes may wait before going out (milliseconds) */
+#ifndef FN_FLUSH_DELAY
+#define FN_FLUSH_DELAY      10
+#endif
+
 /* ============================================================================
  * Error Codes
  * ============================================================================ */
@@ -124,6 +200,12 @@ extern "C" {
 /** Allow handle eviction if no handles available */
 #define FN_OPEN_ALLOW_EVICT 0x08
 
+/** Serve small reads from a read-ahead buffer (library only, not sent) */
+#define FN_OPEN_READ_AHEAD  0x10
+
+/** Coalesce small writes in a write buffer (library only, not sent) */
+#define FN_OPEN_WRITE_BUFFER 0x20
+
 /* ============================================================================
  * Read Response Flags
  * ============================================================================ */
@@ -160,6 +242,29 @@ typedef uint16_t fn_handle_t;
 /** Invalid handle value */
 #define FN_INVALID_HANDLE   0x0000
 
+/** One buffer of a vectored read or write (fn_readv(), fn_writev()) */
+typedef struct {
+    uint8_t *base;          /**< Buffer */
+    uint16_t len;           /**< Buffer size in bytes */
+} fn_iovec_t;
+
+/**
+ * Packet buffers for fn_init_ex(). They must stay valid, and untouched by
+ * the program, for as long as the library is used.
+ */
+typedef struct {
+    uint8_t *req_buf;       /**< Requests are built here */
+    size_t req_size;        /**< Request buffer size (FN_MIN_BUFFER_SIZE or more) */
+    uint8_t *resp_buf;      /**< Responses are received here */
+    size_t resp_size;       /**< Response buffer size (FN_MIN_BUFFER_SIZE or more) */
+    uint8_t *xport_buf;     /**< Transport working space, or NULL */
+    size_t xport_size;      /**< Transport buffer size */
+    uint8_t *ra_buf;        /**< Read-ahead pool, or NULL (see FN_OPEN_READ_AHEAD) */
+    size_t ra_size;         /**< Pool size: FN_READ_AHEAD_SIZE per session using it */
+    uint8_t *wb_buf;        /**< Write buffer pool, or NULL (see FN_OPEN_WRITE_BUFFER) */
+    size_t wb_size;         /**< Pool size: FN_WRITE_BUFFER_SIZE per session using it */
+} fn_buffers_t;
+
 /* ============================================================================
  * Initialization
  * ============================================================================ */
@@ -174,6 +279,24 @@ typedef uint16_t fn_handle_t;
  */
 uint8_t fn_init(void);
 
+/**
+ * @brief Initialize the library with caller-provided packet buffers.
+ * 
+ * Like fn_init(), but requests and responses go through the caller's
+ * memory instead of the library's own arena, which is then not linked.
+ * The frame size, and so the chunk size of reads and writes, is limited
+ * to what both buffers hold.
+ * 
+ * Transports that keep buffers of their own (Linux) use xport_buf for
+ * them while it is large enough for the agreed frame, and allocate
+ * otherwise; others ignore it.
+ * 
+ * @param bufs  Buffers to use (copied; the memory must stay valid)
+ * @return FN_OK on success, FN_ERR_INVALID if a buffer is missing or
+ *         too small, other error code if the transport fails
+ */
+uint8_t fn_init_ex(const fn_buffers_t *bufs);
+
 /**
  * @brief Check if the FujiNet device is present and ready.
  * 
@@ -181,6 +304,17 @@ uint8_t fn_init(void);
  */
 uint8_t fn_is_ready(void);
 
+/**
+ * @brief Get the largest chunk one read or write can move.
+ * 
+ * Depends on the frame size agreed with the device in fn_init(), up to
+ * almost 64 KiB on hosted links. Larger fn_read()/fn_write() requests
+ * are shortened to this.
+ * 
+ * @return Chunk size in bytes (FN_MAX_CHUNK_SIZE before fn_init())
+ */
+uint16_t fn_max_chunk_size(void);
+
 /* ============================================================================
  * Network Operations
  * ============================================================================ */
@@ -203,11 +337,29 @@ uint8_t fn_is_ready(void);
  *   - URL format: "tcp://hostname:port"
  *   - Connection is established asynchronously
  * 
+ * With FN_OPEN_READ_AHEAD, reads shorter than FN_READ_AHEAD_SIZE fetch a
+ * whole buffer from the device and are served from it until it is used
+ * up, so reading line by line costs one exchange per buffer. The buffer
+ * comes from the read-ahead pool (fn_init() has FN_READ_AHEAD_BUFFERS,
+ * fn_init_ex() takes it from the caller) and goes back at fn_close().
+ * With the pool used up, or no pool, the session reads without one. A
+ * library built with FN_READ_AHEAD_BUFFERS at 0, the 8-bit default, has
+ * no read-ahead at all and ignores the flag.
+ * 
+ * With FN_OPEN_WRITE_BUFFER, writes shorter than the chunk size (up to
+ * FN_WRITE_BUFFER_SIZE) are collected in a buffer from a second pool
+ * (FN_WRITE_BUFFERS, which likewise leaves the feature out at 0), and
+ * go out as one WRITE request when the next would not fit, when they
+ * have waited the flush delay (see fn_set_flush_delay()), on fn_flush(),
+ * or before the session is read, queried or closed.
+ * 
  * @param handle     Pointer to receive the session handle
  * @param method     HTTP method (FN_METHOD_*) or 0 for TCP
  * @param url        URL string (null-terminated)
  * @param flags      Open flags (FN_OPEN_*)
- * @return FN_OK on success, error code on failure
+ * @return FN_OK on success, FN_ERR_NO_HANDLES if FN_MAX_SESSIONS are
+ *         open (nothing is sent unless FN_OPEN_ALLOW_EVICT is set), other
+ *         error code on failure
  */
 uint8_t fn_open(fn_handle_t *handle, 
                 uint8_t method,
@@ -235,6 +387,13 @@ uint8_t fn_tcp_open(fn_handle_t *handle,
  * Offsets must be sequential. For HTTP, the request is dispatched
  * automatically when bodyLenHint bytes have been written.
  * 
+ * On a session opened with FN_OPEN_WRITE_BUFFER, FN_OK may only mean the
+ * bytes were buffered: sending them can still fail. That error comes
+ * back from the call that sends them (a later fn_write(), a read,
+ * fn_info(), fn_submit(), fn_flush() or fn_close()), and fn_poll()
+ * reports it in the session's entry. A failed send keeps the bytes
+ * buffered; fn_flush() tries again and says whether they went out.
+ * 
  * @param handle     Session handle
  * @param offset     Byte offset (must be sequential)
  * @param data       Data buffer to write
@@ -271,6 +430,173 @@ uint8_t fn_read(fn_handle_t handle,
                 uint16_t *bytes_read,
                 uint8_t *flags);
 
+/**
+ * @brief Read data from a session without copying it.
+ * 
+ * As fn_read(), but instead of copying the data into a caller's buffer,
+ * points at it in the library's response buffer (or the session's
+ * read-ahead buffer). The data stays valid until the next library call
+ * that talks to the device or reads the session, so it suits consumers
+ * that parse it in place.
+ * 
+ * @param handle      Session handle
+ * @param offset      Byte offset (must be sequential for TCP)
+ * @param max_len     Maximum bytes to read
+ * @param data        Pointer to receive the address of the data
+ * @param bytes_read  Pointer to receive bytes actually read
+ * @param flags       Pointer to receive read flags (FN_READ_*)
+ * @return FN_OK on success, FN_ERR_NOT_READY if no data available
+ */
+uint8_t fn_read_view(fn_handle_t handle,
+                     uint32_t offset,
+                     uint16_t max_len,
+                     const uint8_t **data,
+                     uint16_t *bytes_read,
+                     uint8_t *flags);
+
+/**
+ * @brief Write data gathered from several buffers.
+ * 
+ * Sends the buffers in order, as if they were one, at the session's write
+ * offset. Each WRITE request carries as much as one frame holds (from up
+ * to FN_MAX_WRITEV_SEGMENTS buffers), so several small pieces cost one
+ * exchange rather than one each.
+ * 
+ * Stops early if the device accepts less than it was sent.
+ * 
+ * @param handle     Session handle
+ * @param iov        Buffers to write
+ * @param iovcnt     Number of buffers
+ * @param written    Pointer to receive bytes written (valid on error too)
+ * @return FN_OK on success, error code on failure
+ */
+uint8_t fn_writev(fn_handle_t handle,
+                  const fn_iovec_t *iov,
+                  uint8_t iovcnt,
+                  uint32_t *written);
+
+/**
+ * @brief Read data into several buffers.
+ * 
+ * Fills the buffers in order, as if they were one, reading from offset
+ * as fn_read() does. Each READ request asks for as much as one frame
+ * holds.
+ * 
+ * Stops early at end of data, or when the device has no more data yet.
+ * 
+ * @param handle      Session handle
+ * @param offset      Byte offset (must be sequential for TCP)
+ * @param iov         Buffers to fill
+ * @param iovcnt      Number of buffers
+ * @param bytes_read  Pointer to receive bytes read (valid on error too)
+ * @param flags       Pointer to receive read flags (FN_READ_*)
+ * @return FN_OK if any data was read, FN_ERR_NOT_READY if none available
+ */
+uint8_t fn_readv(fn_handle_t handle,
+                 uint32_t offset,
+                 const fn_iovec_t *iov,
+                 uint8_t iovcnt,
+                 uint32_t *bytes_read,
+                 uint8_t *flags);
+
+/**
+ * @brief Read a large block, keeping several requests in flight.
+ * 
+ * Splits the read into chunks and sends up to depth READ requests
+ * before waiting for the first response, so link latency is paid once
+ * per window rather than once per chunk. Responses are matched to their
+ * requests by the handle and offset they echo.
+ * 
+ * Pipelining needs a transport with FN_TRANSPORT_CAP_PIPELINE and a
+ * session that can be read at any offset (HTTP). Otherwise, or with a
+ * depth of 1, the chunks are read one at a time.
+ * 
+ * Stops early at end of data, or when the device has no more data yet.
+ * 
+ * @param handle      Session handle
+ * @param offset      Byte offset of the first byte to read
+ * @param buf         Buffer to receive data
+ * @param len         Bytes to read (not limited to 64 KiB)
+ * @param depth       Requests in flight (1..FN_MAX_PIPELINE_DEPTH)
+ * @param bytes_read  Pointer to receive bytes read (valid on error too)
+ * @param flags       Pointer to receive read flags (FN_READ_EOF)
+ * @return FN_OK if any data was read, FN_ERR_NOT_READY if none available
+ */
+uint8_t fn_read_pipelined(fn_handle_t handle,
+                          uint32_t offset,
+                          uint8_t *buf,
+                          uint32_t len,
+                          uint8_t depth,
+                          uint32_t *bytes_read,
+                          uint8_t *flags);
+
+/**
+ * @brief One session's part of an fn_read_multi() call.
+ */
+typedef struct {
+    fn_handle_t handle;     /**< Session handle */
+    uint32_t offset;        /**< Byte offset (must be sequential for TCP) */
+    uint8_t *buf;           /**< Buffer to receive data */
+    uint16_t len;           /**< Buffer size */
+    uint16_t bytes_read;    /**< Output: bytes read */
+    uint8_t flags;          /**< Output: read flags (FN_READ_*) */
+    uint8_t result;         /**< Output: FN_OK, FN_ERR_NOT_READY or error code */
+} fn_read_multi_t;
+
+/**
+ * @brief Read from several sessions at once.
+ * 
+ * Asks for each session's data in one READ_MULTI request, and takes every
+ * session's result from one response, so polling many TCP sessions costs
+ * one exchange instead of one per session. The response frame is shared
+ * out in order; sessions that don't fit, or more than FN_MAX_READ_MULTI,
+ * go in further exchanges. Devices without READ_MULTI are read one
+ * session at a time with READ.
+ * 
+ * Each entry gets its own result, as fn_read() would return it.
+ * 
+ * @param reads       Sessions to read, and their results
+ * @param count       Number of entries
+ * @return FN_OK if any session had data, FN_ERR_NOT_READY if none had,
+ *         other error code if the exchange failed
+ */
+uint8_t fn_read_multi(fn_read_multi_t *reads, uint8_t count);
+
+/**
+ * @brief State of one session, from fn_poll().
+ */
+typedef struct {
+    fn_handle_t handle;     /**< Session handle */
+    uint8_t flags;          /**< Info flags (FN_INFO_*), as fn_info() reports them */
+    uint8_t result;         /**< FN_OK, or the error asking about this session */
+    uint16_t available;     /**< Bytes ready to read (0 if none or unknown) */
+} fn_poll_t;
+
+/**
+ * @brief Get the state of every open session.
+ * 
+ * Asks for the state of all the library's sessions in one POLL request
+ * (more if they don't fit one frame), so finding which of many TCP
+ * sessions have data or have closed costs one exchange instead of an
+ * fn_read() or fn_info() each. Data already in a session's read-ahead
+ * buffer counts as available. Buffered writes are sent first; if a
+ * session's can't be, its entry's result is that error, whatever the
+ * device reported for it.
+ * 
+ * Devices without POLL are asked with INFO, one session at a time, and
+ * report no available byte counts. An entry's result is what fn_info()
+ * returned for it then; the other sessions are still asked.
+ * 
+ * @param sessions   Array to receive one entry per open session
+ * @param max        Size of the array
+ * @param count      Pointer to receive the number of entries filled, or
+ *                   the number of open sessions if max is too small
+ * @return FN_OK on success, FN_ERR_INVALID if max is smaller than the
+ *         number of open sessions (nothing is polled), other error code
+ *         if a POLL exchange failed
+ */
+uint8_t fn_poll(fn_poll_t *sessions, uint16_t max, uint16_t *count);
+
 /**
  * @brief Get session information.
  * 
@@ -288,16 +614,120 @@ uint8_t fn_info(fn_handle_t handle,
                 uint32_t *content_length,
                 uint8_t *flags);
 
+/**
+ * @brief Send a session's buffered writes (FN_OPEN_WRITE_BUFFER).
+ * 
+ * Returns at once if nothing is buffered. If the device takes only part
+ * of the data (e.g. a full TCP window), the rest stays buffered. Call it
+ * to find out whether writes fn_write() reported as done have reached
+ * the device: a send that failed in the background (see
+ * fn_set_flush_delay()) leaves the data buffered, and is tried again
+ * here.
+ * 
+ * @param handle     Session handle
+ * @return FN_OK when the buffer is empty, FN_ERR_BUSY if the device took
+ *         none of it, other error code on failure
+ */
+uint8_t fn_flush(fn_handle_t handle);
+
+/**
+ * @brief Set how long buffered writes may wait before going out.
+ * 
+ * The delay is checked whenever the library writes or reads, so data
+ * can wait longer while the program makes no library calls; fn_flush()
+ * sends it at once. Platforms without a clock (all but Linux and the
+ * Atari) only flush on size and on fn_flush(), reads, info and close.
+ * 
+ * @param ms         Delay in milliseconds (FN_FLUSH_DELAY by default),
+ *                   0 to flush only on size and explicitly
+ */
+void fn_set_flush_delay(uint16_t ms);
+
 /**
  * @brief Close a network session.
  * 
- * Releases the session handle and any associated resources.
+ * Releases the session handle and any associated resources. Buffered
+ * writes are sent first; if that fails, the session is closed anyway
+ * and the error returned, so the data is lost.
  * 
  * @param handle     Session handle to close
- * @return FN_OK on success, error code on failure
+ * @return FN_OK on success, FN_ERR_BUSY (session left open) while an
+ *         async operation is on the link, error code on failure
+ *         (including one sending buffered writes)
  */
 uint8_t fn_close(fn_handle_t handle);
 
+/* ============================================================================
+ * Asynchronous Operations
+ * ============================================================================ */
+
+/** Asynchronous operation codes (fn_request_t.op) */
+#define FN_OP_READ          0x01
+#define FN_OP_WRITE         0x02
+#define FN_OP_INFO          0x03
+
+/**
+ * @brief An asynchronous operation for fn_submit().
+ * 
+ * buf must stay valid until the operation's completion is harvested.
+ */
+typedef struct {
+    uint8_t op;             /**< FN_OP_READ, FN_OP_WRITE or FN_OP_INFO */
+    uint8_t tag;            /**< Caller's value, returned in the completion */
+    fn_handle_t handle;     /**< Session handle */
+    uint32_t offset;        /**< READ/WRITE: byte offset */
+    uint8_t *buf;           /**< READ: destination, WRITE: source */
+    uint16_t len;           /**< READ: buffer size, WRITE: bytes to write */
+} fn_request_t;
+
+/**
+ * @brief Result of a finished asynchronous operation.
+ */
+typedef struct {
+    uint8_t op;             /**< Operation code from the request */
+    uint8_t tag;            /**< Tag from the request */
+    fn_handle_t handle;     /**< Session handle from the request */
+    uint8_t status;         /**< FN_OK or error code */
+    uint8_t flags;          /**< READ: FN_READ_*, INFO: FN_INFO_* */
+    uint16_t count;         /**< READ/WRITE: bytes moved, INFO: HTTP status */
+    uint32_t length;        /**< INFO: content length */
+} fn_completion_t;
+
+/**
+ * @brief Queue an operation without waiting for it.
+ * 
+ * Operations run one at a time, in submission order, as fn_step() or
+ * fn_poll_completions() is called. While one is on the link, the
+ * blocking calls (fn_read(), fn_write(), ...) return FN_ERR_BUSY.
+ * A READ of data the session has read ahead (FN_OPEN_READ_AHEAD) is
+ * served from that buffer, as by fn_read().
+ * 
+ * @param req    Operation to queue (copied)
+ * @return FN_OK if queued, FN_ERR_BUSY if FN_MAX_ASYNC_OPS are pending
+ *         or unharvested, FN_ERR_NOT_FOUND for an unknown handle
+ */
+uint8_t fn_submit(const fn_request_t *req);
+
+/**
+ * @brief Advance queued operations.
+ * 
+ * Cooperative step for the main loop. Where the transport can wait
+ * without blocking (Linux), it sends the next request or checks for its
+ * response and returns at once. Elsewhere it runs one complete exchange.
+ */
+void fn_step(void);
+
+/**
+ * @brief Harvest finished operations.
+ * 
+ * Calls fn_step() once, then copies out completions in submission order.
+ * 
+ * @param out    Array to receive completions
+ * @param max    Size of the out array
+ * @return Number of completions copied
+ */
+uint8_t fn_poll_completions(fn_completion_t *out, uint8_t max);
+
 /* ============================================================================
  * Clock Operations
  * ============================================================================ */
@@ -36,6 +36,8 @@ LIBRARY     := $(BUILDDIR)/$(PROGRAM)-$(TARGET)$(LIBEXT)
 COMMON_SRCS := $(SRCDIR)/common/fn_slip.c \
                $(SRCDIR)/common/fn_packet.c \
                $(SRCDIR)/common/fn_network.c \
+               $(SRCDIR)/common/fn_arena.c \
+               $(SRCDIR)/common/fn_async.c \
                $(SRCDIR)/common/fn_clock.c
 
 # Platform-specific sources
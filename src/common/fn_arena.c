@@ -0,0 +1,55 @@
+/**
+ * @file fn_arena.c
+ * @brief FujiNet-NIO Default Packet Arena
+ * 
+ * fn_init() with the library's own packet buffers, read-ahead and write
+ * buffer pools. Kept apart from fn_network.c so that programs calling
+ * fn_init_ex() don't link them.
+ * 
+ * @version 1.0.0
+ */
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+#include "fn_platform.h"
+#include "fn_internal.h"
+
+/** Default packet arena: requests first, then responses */
+static uint8_t _arena[FN_ARENA_SIZE];
+
+#if FN_READ_AHEAD_BUFFERS > 0
+/** Default read-ahead pool (FN_OPEN_READ_AHEAD) */
+static uint8_t _read_ahead[FN_READ_AHEAD_BUFFERS * FN_READ_AHEAD_SIZE];
+#endif
+
+#if FN_WRITE_BUFFERS > 0
+/** Default write buffer pool (FN_OPEN_WRITE_BUFFER) */
+static uint8_t _write_buffers[FN_WRITE_BUFFERS * FN_WRITE_BUFFER_SIZE];
+#endif
+
+uint8_t fn_init(void)
+{
+    fn_buffers_t bufs;
+    
+    bufs.req_buf = _arena;
+    bufs.req_size = FN_MAX_FRAME_SIZE;
+    bufs.resp_buf = _arena + FN_MAX_FRAME_SIZE;
+    bufs.resp_size = FN_MAX_FRAME_SIZE;
+    bufs.xport_buf = NULL;
+    bufs.xport_size = 0;
+#if FN_READ_AHEAD_BUFFERS > 0
+    bufs.ra_buf = _read_ahead;
+    bufs.ra_size = sizeof(_read_ahead);
+#else
+    bufs.ra_buf = NULL;
+    bufs.ra_size = 0;
+#endif
+#if FN_WRITE_BUFFERS > 0
+    bufs.wb_buf = _write_buffers;
+    bufs.wb_size = sizeof(_write_buffers);
+#else
+    bufs.wb_buf = NULL;
+    bufs.wb_size = 0;
+#endif
+    return fn_init_ex(&bufs);
+}
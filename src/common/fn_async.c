@@ -0,0 +1,337 @@
+/**
+ * @file fn_async.c
+ * @brief FujiNet-NIO Asynchronous Operations
+ *
+ * Submission and completion queues for fn_submit() / fn_poll_completions().
+ * Operations run one at a time from the head of the submission queue.
+ * Transports with FN_TRANSPORT_CAP_ASYNC send the request and poll for the
+ * response across several fn_step() calls; others do a whole exchange in
+ * one step.
+ *
+ * @version 1.0.0
+ */
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+#include "fn_platform.h"
+#include "fn_internal.h"
+#include <string.h>
+
+/* ============================================================================
+ * Internal State
+ * ============================================================================ */
+
+/** Submission queue (ring) */
+static fn_request_t _sq[FN_MAX_ASYNC_OPS];
+static uint8_t _sq_head = 0;
+static uint8_t _sq_count = 0;
+
+/** Completion queue (ring) */
+static fn_completion_t _cq[FN_MAX_ASYNC_OPS];
+static uint8_t _cq_head = 0;
+static uint8_t _cq_count = 0;
+
+/* ============================================================================
+ * Internal Helpers
+ * ============================================================================ */
+
+/**
+ * Build the request packet for an operation.
+ * Returns the packet length, or 0 with *status set if it can't be sent.
+ */
+static uint16_t _build(const fn_request_t *req, uint8_t *status)
+{
+    fn_session_t *session;
+    uint16_t len;
+    
+    session = fn_session_find(req->handle);
+    if (session == NULL) {
+        *status = FN_ERR_NOT_FOUND;
+        return 0;
+    }
+    
+    *status = FN_ERR_INVALID;
+    
+    switch (req->op) {
+        case FN_OP_READ:
+            len = req->len;
+            if (len > fn_max_frame - FN_READ_RESP_OVERHEAD) {
+                len = fn_max_frame - FN_READ_RESP_OVERHEAD;
+            }
+            return fn_build_read_packet(fn_req_buf, req->handle, req->offset, len);
+        
+        case FN_OP_WRITE:
+            if (req->offset != session->write_offset) {
+                return 0;
+            }
+            len = req->len;
+            if (len > fn_max_frame - FN_WRITE_REQ_OVERHEAD) {
+                len = fn_max_frame - FN_WRITE_REQ_OVERHEAD;
+            }
+            return fn_build_write_packet(fn_req_buf, req->handle, req->offset, req->buf, len);
+        
+        case FN_OP_INFO:
+            return fn_build_info_packet(fn_req_buf, req->handle);
+    }
+    
+    return 0;
+}
+
+/**
+ * Take the next completion for the operation at the head of the
+ * submission queue.
+ */
+static fn_completion_t *_new_completion(const fn_request_t *req)
+{
+    fn_completion_t *c;
+    
+    c = &_cq[(_cq_head + _cq_count) % FN_MAX_ASYNC_OPS];
+    _cq_count++;
+    
+    c->op = req->op;
+    c->tag = req->tag;
+    c->handle = req->handle;
+    c->flags = 0;
+    c->count = 0;
+    c->length = 0;
+    return c;
+}
+
+/**
+ * Finish the operation at the head of the submission queue with its
+ * completion filled in.
+ */
+static void _retire(const fn_request_t *req, fn_completion_t *c, uint8_t result)
+{
+    fn_session_t *session;
+    
+    c->status = result;
+    
+    /* Keep the session offsets in step, as the blocking calls do */
+    session = fn_session_find(req->handle);
+    if (result == FN_OK && session != NULL) {
+        if (req->op == FN_OP_WRITE) {
+            session->write_offset += c->count;
+        } else if (req->op == FN_OP_READ &&
+                   (session->proto_flags & FN_PROTO_FLAG_SEQUENTIAL_READ)) {
+            session->read_offset += c->count;
+        }
+    }
+    
+    _sq_head = (_sq_head + 1) % FN_MAX_ASYNC_OPS;
+    _sq_count--;
+}
+
+#if FN_READ_AHEAD_BUFFERS > 0
+/**
+ * Serve a READ from the session's read-ahead buffer if it holds the
+ * offset, as fn_read() does. On a sequential session that data has
+ * already left the device, so it must not be asked for again.
+ * Returns 1 if the operation is finished.
+ */
+static uint8_t _read_buffered(const fn_request_t *req)
+{
+    fn_completion_t *c;
+    fn_session_t *session;
+    uint32_t pos;
+    
+    if (req->op != FN_OP_READ) {
+        return 0;
+    }
+    session = fn_session_find(req->handle);
+    if (session == NULL || session->ra_buf == NULL) {
+        return 0;
+    }
+    pos = req->offset - session->ra_offset;
+    if (pos >= session->ra_len) {
+        return 0;
+    }
+    
+    c = _new_completion(req);
+    c->count = session->ra_len - (uint16_t)pos;
+    c->flags = session->ra_flags;
+    if (c->count > req->len) {
+        c->count = req->len;
+        c->flags = 0;
+    }
+    memcpy(req->buf, session->ra_buf + (uint16_t)pos, c->count);
+    _retire(req, c, FN_OK);
+    return 1;
+}
+#endif
+
+/**
+ * Fill a completion from the exchange result and response packet.
+ */
+static void _complete(const fn_request_t *req, uint8_t result, uint16_t resp_len)
+{
+    fn_completion_t *c;
+    fn_handle_t resp_handle;
+    uint32_t offset_echo;
+    uint8_t status;
+    uint16_t data_offset;
+    uint16_t data_len;
+    
+    c = _new_completion(req);
+    
+    if (result == FN_OK) {
+        switch (req->op) {
+            case FN_OP_READ:
+                result = fn_parse_read_response(fn_resp_buf, resp_len, &resp_handle, &offset_echo,
+                                                &c->flags, req->buf, req->len, &c->count);
+                if (result == FN_OK &&
+                    (resp_handle != req->handle || offset_echo != req->offset)) {
+                    result = FN_ERR_IO;
+                }
+                if (result == FN_OK && c->count > req->len) {
+                    c->count = req->len;
+                }
+                break;
+            
+            case FN_OP_WRITE:
+                result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
+                if (result == FN_OK) {
+                    result = status;
+                }
+                if (result == FN_OK && data_len >= 12) {
+                    c->count = fn_resp_buf[data_offset + 10] | (fn_resp_buf[data_offset + 11] << 8);
+                }
+                break;
+            
+            case FN_OP_INFO:
+                result = fn_parse_info_response(fn_resp_buf, resp_len, &resp_handle,
+                                                &c->count, &c->length, &c->flags);
+                if (result == FN_OK && resp_handle != req->handle) {
+                    result = FN_ERR_IO;
+                }
+                break;
+        }
+    }
+    
+    _retire(req, c, result);
+}
+
+/* ============================================================================
+ * Asynchronous Operations
+ * ============================================================================ */
+
+uint8_t fn_submit(const fn_request_t *req)
+{
+    fn_session_t *session;
+#if FN_WRITE_BUFFERS > 0
+    uint8_t result;
+#endif
+    
+    if (req == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (req->op != FN_OP_INFO && req->buf == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (req->op != FN_OP_READ && req->op != FN_OP_WRITE && req->op != FN_OP_INFO) {
+        return FN_ERR_INVALID;
+    }
+    
+    session = fn_session_find(req->handle);
+    if (session == NULL) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+#if FN_WRITE_BUFFERS > 0
+    /* Queued operations see the session's buffered writes as sent */
+    if (session->wb_len > 0) {
+        result = fn_flush(req->handle);
+        if (result != FN_OK) {
+            return result;
+        }
+    }
+#endif
+    
+    /* Every pending operation must have room for its completion */
+    if (_sq_count + _cq_count >= FN_MAX_ASYNC_OPS) {
+        return FN_ERR_BUSY;
+    }
+    
+    memcpy(&_sq[(_sq_head + _sq_count) % FN_MAX_ASYNC_OPS], req, sizeof(fn_request_t));
+    _sq_count++;
+    
+    return FN_OK;
+}
+
+void fn_step(void)
+{
+    const fn_request_t *req;
+    uint16_t req_len;
+    uint16_t resp_len;
+    uint8_t result;
+    
+    if (_sq_count == 0) {
+        return;
+    }
+    
+    req = &_sq[_sq_head];
+    resp_len = 0;
+    
+#if FN_READ_AHEAD_BUFFERS > 0
+    /* Data already read ahead is served without an exchange */
+    if (!fn_async_busy && _read_buffered(req)) {
+        return;
+    }
+#endif
+
+#ifndef FN_TRANSPORT_DIRECT
+    if (FN_TRANSPORT_CAPS() & FN_TRANSPORT_CAP_ASYNC) {
+        if (!fn_async_busy) {
+            req_len = _build(req, &result);
+            if (req_len == 0) {
+                _complete(req, result, 0);
+                return;
+            }
+            
+            /* Whatever is unread (a late response) isn't this reply */
+            FN_TRANSPORT_DISCARD();
+            result = FN_TRANSPORT_SEND(fn_req_buf, req_len);
+            if (result != FN_OK) {
+                _complete(req, result, 0);
+                return;
+            }
+            fn_async_busy = 1;
+        }
+        
+        result = FN_TRANSPORT_POLL(fn_resp_buf, fn_max_frame, &resp_len);
+        if (result == FN_ERR_NOT_READY) {
+            return;
+        }
+        
+        fn_async_busy = 0;
+        _complete(req, result, resp_len);
+        return;
+    }
+#endif
+    
+    /* Blocking transports: the whole exchange happens in this step */
+    req_len = _build(req, &result);
+    if (req_len != 0) {
+        result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
+    }
+    _complete(req, result, resp_len);
+}
+
+uint8_t fn_poll_completions(fn_completion_t *out, uint8_t max)
+{
+    uint8_t n;
+    
+    fn_step();
+    
+    n = 0;
+    while (n < max && _cq_count > 0) {
+        memcpy(&out[n], &_cq[_cq_head], sizeof(fn_completion_t));
+        _cq_head = (_cq_head + 1) % FN_MAX_ASYNC_OPS;
+        _cq_count--;
+        n++;
+    }
+    
+    return n;
+}
@@ -13,13 +13,6 @@
 #include "fn_platform.h"
 #include "fn_internal.h"
 
-/* ============================================================================
- * Static Buffers (for cc65 compatibility - no large stack buffers)
- * ============================================================================ */
-
-static uint8_t _clock_req_buf[FN_MAX_PACKET_SIZE];
-static uint8_t _clock_resp_buf[FN_MAX_PACKET_SIZE];
-
 /* ============================================================================
  * Clock Operations
  * ============================================================================ */
@@ -44,27 +37,31 @@ uint8_t fn_clock_get(FN_TIME_T *time)
     uint8_t version;
     uint8_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (time == NULL) {
         return FN_ERR_INVALID;
     }
     
     /* Build request packet header (no payload needed for GetTime) */
-    req_len = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET, FN_HEADER_SIZE);
+    req_len = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET, FN_HEADER_SIZE);
     if (req_len == 0) {
         return FN_ERR_INTERNAL;
     }
     
     /* Finalize checksum */
-    _clock_req_buf[4] = fn_calc_checksum(_clock_req_buf, req_len);
+    fn_req_buf[4] = fn_calc_checksum(fn_req_buf, req_len);
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, req_len, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -79,7 +76,7 @@ uint8_t fn_clock_get(FN_TIME_T *time)
     }
     
     /* Parse time payload */
-    version = _clock_resp_buf[data_offset];
+    version = fn_resp_buf[data_offset];
     if (version != FN_CLOCK_VERSION) {
         return FN_ERR_UNSUPPORTED;
     }
@@ -87,12 +84,12 @@ uint8_t fn_clock_get(FN_TIME_T *time)
     /* Copy 8-byte timestamp to output (little-endian) */
 #ifdef __CC65__
     for (i = 0; i < 8; i++) {
-        time->b[i] = _clock_resp_buf[data_offset + 4 + i];
+        time->b[i] = fn_resp_buf[data_offset + 4 + i];
     }
 #else
     *time = 0;
     for (i = 0; i < 8; i++) {
-        *time |= ((uint64_t)_clock_resp_buf[data_offset + 4 + i]) << (8 * i);
+        *time |= ((uint64_t)fn_resp_buf[data_offset + 4 + i]) << (8 * i);
     }
 #endif
     
@@ -122,6 +119,10 @@ uint8_t fn_clock_set(const FN_TIME_T *time)
     uint8_t checksum;
     uint8_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (time == NULL) {
         return FN_ERR_INVALID;
     }
@@ -131,34 +132,34 @@ uint8_t fn_clock_set(const FN_TIME_T *time)
     total_len = FN_HEADER_SIZE + payload_len;
     
     /* Build header */
-    offset = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SET, total_len);
+    offset = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SET, total_len);
     
     /* Version */
-    _clock_req_buf[offset++] = FN_CLOCK_VERSION;
+    fn_req_buf[offset++] = FN_CLOCK_VERSION;
     
     /* Unix timestamp (little-endian) */
 #ifdef __CC65__
     for (i = 0; i < 8; i++) {
-        _clock_req_buf[offset++] = time->b[i];
+        fn_req_buf[offset++] = time->b[i];
     }
 #else
     for (i = 0; i < 8; i++) {
-        _clock_req_buf[offset++] = (uint8_t)((*time >> (8 * i)) & 0xFF);
+        fn_req_buf[offset++] = (uint8_t)((*time >> (8 * i)) & 0xFF);
     }
 #endif
     
     /* Calculate and insert checksum */
-    checksum = fn_calc_checksum(_clock_req_buf, offset);
-    _clock_req_buf[4] = checksum;
+    checksum = fn_calc_checksum(fn_req_buf, offset);
+    fn_req_buf[4] = checksum;
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, offset, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, offset, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -191,31 +192,35 @@ uint8_t fn_clock_get_format(uint8_t *time_data, FnTimeFormat format)
     uint8_t resp_format;
     uint16_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (time_data == NULL) {
         return FN_ERR_INVALID;
     }
     
     /* Build request packet: version(1) + format(1) = 2 bytes payload */
-    req_len = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET_FORMAT, FN_HEADER_SIZE + 2);
+    req_len = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET_FORMAT, FN_HEADER_SIZE + 2);
     if (req_len == 0) {
         return FN_ERR_INTERNAL;
     }
     
     /* Add payload */
-    _clock_req_buf[req_len++] = FN_CLOCK_VERSION;
-    _clock_req_buf[req_len++] = (uint8_t)format;
+    fn_req_buf[req_len++] = FN_CLOCK_VERSION;
+    fn_req_buf[req_len++] = (uint8_t)format;
     
     /* Finalize checksum */
-    _clock_req_buf[4] = fn_calc_checksum(_clock_req_buf, req_len);
+    fn_req_buf[4] = fn_calc_checksum(fn_req_buf, req_len);
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, req_len, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -230,8 +235,8 @@ uint8_t fn_clock_get_format(uint8_t *time_data, FnTimeFormat format)
     }
     
     /* Parse response */
-    version = _clock_resp_buf[data_offset];
-    resp_format = _clock_resp_buf[data_offset + 1];  /* Echo of requested format */
+    version = fn_resp_buf[data_offset];
+    resp_format = fn_resp_buf[data_offset + 1];  /* Echo of requested format */
     (void)resp_format;  /* Unused but kept for protocol documentation */
     
     if (version != FN_CLOCK_VERSION) {
@@ -240,7 +245,7 @@ uint8_t fn_clock_get_format(uint8_t *time_data, FnTimeFormat format)
     
     /* Copy formatted time to output (skip version and format bytes) */
     for (i = 0; i < data_len - 2; i++) {
-        time_data[i] = _clock_resp_buf[data_offset + 2 + i];
+        time_data[i] = fn_resp_buf[data_offset + 2 + i];
     }
     
     return FN_OK;
@@ -261,6 +266,10 @@ uint8_t fn_clock_get_tz(uint8_t *time_data, const char *tz, FnTimeFormat format)
     uint8_t tz_len;
     uint16_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (time_data == NULL || tz == NULL) {
         return FN_ERR_INVALID;
     }
@@ -272,30 +281,30 @@ uint8_t fn_clock_get_tz(uint8_t *time_data, const char *tz, FnTimeFormat format)
     }
     
     /* Build request packet: version(1) + format(1) + tz_len(1) + tz(n) */
-    req_len = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET_FORMAT, FN_HEADER_SIZE + 3 + tz_len);
+    req_len = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET_FORMAT, FN_HEADER_SIZE + 3 + tz_len);
     if (req_len == 0) {
         return FN_ERR_INTERNAL;
     }
     
     /* Add payload */
-    _clock_req_buf[req_len++] = FN_CLOCK_VERSION;
-    _clock_req_buf[req_len++] = (uint8_t)format;
-    _clock_req_buf[req_len++] = tz_len;
+    fn_req_buf[req_len++] = FN_CLOCK_VERSION;
+    fn_req_buf[req_len++] = (uint8_t)format;
+    fn_req_buf[req_len++] = tz_len;
     for (i = 0; i < tz_len; i++) {
-        _clock_req_buf[req_len++] = (uint8_t)tz[i];
+        fn_req_buf[req_len++] = (uint8_t)tz[i];
     }
     
     /* Finalize checksum */
-    _clock_req_buf[4] = fn_calc_checksum(_clock_req_buf, req_len);
+    fn_req_buf[4] = fn_calc_checksum(fn_req_buf, req_len);
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, req_len, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -310,14 +319,14 @@ uint8_t fn_clock_get_tz(uint8_t *time_data, const char *tz, FnTimeFormat format)
     }
     
     /* Parse response */
-    version = _clock_resp_buf[data_offset];
+    version = fn_resp_buf[data_offset];
     if (version != FN_CLOCK_VERSION) {
         return FN_ERR_UNSUPPORTED;
     }
     
     /* Copy formatted time to output (skip version and format bytes) */
     for (i = 0; i < data_len - 2; i++) {
-        time_data[i] = _clock_resp_buf[data_offset + 2 + i];
+        time_data[i] = fn_resp_buf[data_offset + 2 + i];
     }
     
     return FN_OK;
@@ -343,27 +352,31 @@ uint8_t fn_clock_get_timezone(char *tz)
     uint8_t tz_len;
     uint16_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (tz == NULL) {
         return FN_ERR_INVALID;
     }
     
     /* Build request packet header (no payload needed) */
-    req_len = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET_TZ, FN_HEADER_SIZE);
+    req_len = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_GET_TZ, FN_HEADER_SIZE);
     if (req_len == 0) {
         return FN_ERR_INTERNAL;
     }
     
     /* Finalize checksum */
-    _clock_req_buf[4] = fn_calc_checksum(_clock_req_buf, req_len);
+    fn_req_buf[4] = fn_calc_checksum(fn_req_buf, req_len);
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, req_len, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -378,8 +391,8 @@ uint8_t fn_clock_get_timezone(char *tz)
     }
     
     /* Parse response */
-    version = _clock_resp_buf[data_offset];
-    tz_len = _clock_resp_buf[data_offset + 1];
+    version = fn_resp_buf[data_offset];
+    tz_len = fn_resp_buf[data_offset + 1];
     
     if (version != FN_CLOCK_VERSION) {
         return FN_ERR_UNSUPPORTED;
@@ -387,7 +400,7 @@ uint8_t fn_clock_get_timezone(char *tz)
     
     /* Copy timezone string to output */
     for (i = 0; i < tz_len && i < FN_MAX_TIMEZONE_LEN - 1; i++) {
-        tz[i] = (char)_clock_resp_buf[data_offset + 2 + i];
+        tz[i] = (char)fn_resp_buf[data_offset + 2 + i];
     }
     tz[i] = '\0';
     
@@ -413,6 +426,10 @@ uint8_t fn_clock_set_timezone(const char *tz)
     uint8_t tz_len;
     uint16_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (tz == NULL) {
         return FN_ERR_INVALID;
     }
@@ -424,29 +441,29 @@ uint8_t fn_clock_set_timezone(const char *tz)
     }
     
     /* Build request packet: version(1) + length(1) + tz(n) */
-    req_len = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SET_TZ, FN_HEADER_SIZE + 2 + tz_len);
+    req_len = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SET_TZ, FN_HEADER_SIZE + 2 + tz_len);
     if (req_len == 0) {
         return FN_ERR_INTERNAL;
     }
     
     /* Add payload */
-    _clock_req_buf[req_len++] = FN_CLOCK_VERSION;
-    _clock_req_buf[req_len++] = tz_len;
+    fn_req_buf[req_len++] = FN_CLOCK_VERSION;
+    fn_req_buf[req_len++] = tz_len;
     for (i = 0; i < tz_len; i++) {
-        _clock_req_buf[req_len++] = (uint8_t)tz[i];
+        fn_req_buf[req_len++] = (uint8_t)tz[i];
     }
     
     /* Finalize checksum */
-    _clock_req_buf[4] = fn_calc_checksum(_clock_req_buf, req_len);
+    fn_req_buf[4] = fn_calc_checksum(fn_req_buf, req_len);
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, req_len, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -468,6 +485,10 @@ uint8_t fn_clock_set_timezone_save(const char *tz)
     uint8_t tz_len;
     uint16_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (tz == NULL) {
         return FN_ERR_INVALID;
     }
@@ -479,29 +500,29 @@ uint8_t fn_clock_set_timezone_save(const char *tz)
     }
     
     /* Build request packet: version(1) + length(1) + tz(n) */
-    req_len = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SET_TZ_SAVE, FN_HEADER_SIZE + 2 + tz_len);
+    req_len = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SET_TZ_SAVE, FN_HEADER_SIZE + 2 + tz_len);
     if (req_len == 0) {
         return FN_ERR_INTERNAL;
     }
     
     /* Add payload */
-    _clock_req_buf[req_len++] = FN_CLOCK_VERSION;
-    _clock_req_buf[req_len++] = tz_len;
+    fn_req_buf[req_len++] = FN_CLOCK_VERSION;
+    fn_req_buf[req_len++] = tz_len;
     for (i = 0; i < tz_len; i++) {
-        _clock_req_buf[req_len++] = (uint8_t)tz[i];
+        fn_req_buf[req_len++] = (uint8_t)tz[i];
     }
     
     /* Finalize checksum */
-    _clock_req_buf[4] = fn_calc_checksum(_clock_req_buf, req_len);
+    fn_req_buf[4] = fn_calc_checksum(fn_req_buf, req_len);
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, req_len, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -532,30 +553,34 @@ uint8_t fn_clock_sync_network_time(FN_TIME_T *time)
     uint8_t version;
     uint8_t i;
     
+    if (fn_req_buf == NULL) {
+        return FN_ERR_INVALID;     /* fn_init() not called */
+    }
+    
     if (time == NULL) {
         return FN_ERR_INVALID;
     }
     
     /* Build request packet: version(1) = 1 byte payload */
-    req_len = fn_build_header(_clock_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SYNC_NETWORK_TIME, FN_HEADER_SIZE + 1);
+    req_len = fn_build_header(fn_req_buf, FN_DEVICE_CLOCK, FN_CMD_CLOCK_SYNC_NETWORK_TIME, FN_HEADER_SIZE + 1);
     if (req_len == 0) {
         return FN_ERR_INTERNAL;
     }
     
     /* Add payload */
-    _clock_req_buf[req_len++] = FN_CLOCK_VERSION;
+    fn_req_buf[req_len++] = FN_CLOCK_VERSION;
     
     /* Finalize checksum */
-    _clock_req_buf[4] = fn_calc_checksum(_clock_req_buf, req_len);
+    fn_req_buf[4] = fn_calc_checksum(fn_req_buf, req_len);
     
     /* Send request and receive response */
-    result = fn_transport_exchange(_clock_req_buf, req_len, _clock_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
     /* Parse response header */
-    result = fn_parse_response_header(_clock_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -570,7 +595,7 @@ uint8_t fn_clock_sync_network_time(FN_TIME_T *time)
     }
     
     /* Parse response */
-    version = _clock_resp_buf[data_offset];
+    version = fn_resp_buf[data_offset];
     if (version != FN_CLOCK_VERSION) {
         return FN_ERR_UNSUPPORTED;
     }
@@ -578,12 +603,12 @@ uint8_t fn_clock_sync_network_time(FN_TIME_T *time)
     /* Copy 8-byte timestamp to output (little-endian) */
 #ifdef __CC65__
     for (i = 0; i < 8; i++) {
-        time->b[i] = _clock_resp_buf[data_offset + 4 + i];
+        time->b[i] = fn_resp_buf[data_offset + 4 + i];
     }
 #else
     *time = 0;
     for (i = 0; i < 8; i++) {
-        *time |= ((uint64_t)_clock_resp_buf[data_offset + 4 + i]) << (8 * i);
+        *time |= ((uint64_t)fn_resp_buf[data_offset + 4 + i]) << (8 * i);
     }
 #endif
     
@@ -18,50 +18,333 @@
  * Internal State
  * ============================================================================ */
 
-/** Session tracking table */
-static fn_session_t _sessions[FN_MAX_SESSIONS];
+/** Session tracking table, hashed on the handle (linear probing) */
+static fn_session_t _sessions[FN_SESSION_TABLE_SIZE];
+
+/** Sessions in the table */
+static uint16_t _session_count = 0;
+
+#define SESSION_MASK  (FN_SESSION_TABLE_SIZE - 1)
 
 /** Library initialized flag */
 static uint8_t _initialized = 0;
 
+/** Largest packet the link carries (and our buffers hold) */
+uint16_t fn_max_frame;
+
+/** Set while an asynchronous operation owns the link */
+uint8_t fn_async_busy = 0;
+
+/** Set while exchanging a request whose response may be given up on early */
+uint8_t fn_exchange_adaptive = 0;
+
+/** Set when the last response arrived damaged */
+uint8_t fn_frame_damaged = 0;
+
+/* Packet buffers: the library's only ones (no large stack buffers for CC65) */
+uint8_t *fn_req_buf = NULL;
+uint8_t *fn_resp_buf = NULL;
+uint16_t fn_wire_size = 0;
+
+/**
+ * Pool of same-sized session buffers. Buffers never handed out start at
+ * next; those given back are linked through their first bytes.
+ */
+typedef struct {
+    uint8_t *next;
+    uint8_t *end;
+    uint8_t *free;
+    uint16_t size;
+} fn_pool_t;
+
+#if FN_READ_AHEAD_BUFFERS > 0
+/** Read-ahead buffer pool (FN_OPEN_READ_AHEAD) */
+static fn_pool_t _ra_pool;
+#endif
+
+#if FN_WRITE_BUFFERS > 0
+/** Write buffer pool (FN_OPEN_WRITE_BUFFER) */
+static fn_pool_t _wb_pool;
+
+/** Sessions with buffered writes */
+static uint16_t _wb_pending = 0;
+#endif
+
+/** Time buffered writes may wait (ms, 0 for no limit) */
+static uint16_t _flush_delay = FN_FLUSH_DELAY;
+
+/** Cleared once the device turns READ_MULTI down */
+static uint8_t _read_multi_ok = 1;
+
+/** Cleared once the device turns POLL down */
+static uint8_t _poll_ok = 1;
+
+/** READ_MULTI request being built, and the fn_read_multi() entry of each */
+static fn_read_req_t _multi_reqs[FN_MAX_READ_MULTI];
+static uint8_t _multi_index[FN_MAX_READ_MULTI];
+
+#ifndef FN_TRANSPORT_DIRECT
+static uint8_t _null_init(void)
+{
+    return FN_ERR_NOT_FOUND;
+}
+
+static uint8_t _null_ready(void)
+{
+    return 0;
+}
+
+static uint8_t _null_exchange(const uint8_t *request,
+                              uint16_t req_len,
+                              uint8_t *response,
+                              uint16_t resp_max,
+                              uint16_t *resp_len)
+{
+    (void)request;
+    (void)req_len;
+    (void)response;
+    (void)resp_max;
+    (void)resp_len;
+    return FN_ERR_NOT_FOUND;
+}
+
+/** Placeholder until a transport is chosen, so early calls fail cleanly */
+static const fn_transport_ops_t _null_transport = {
+    "none",
+    FN_HEADER_SIZE,
+    0,
+    _null_init,
+    _null_ready,
+    _null_exchange,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+/** Active transport operations */
+const fn_transport_ops_t *fn_transport = &_null_transport;
+#endif
+
 /* ============================================================================
  * Internal Helpers
  * ============================================================================ */
 
+#if FN_READ_AHEAD_BUFFERS > 0 || FN_WRITE_BUFFERS > 0
 /**
- * Find a free session slot.
+ * Set up a pool in buf (none if NULL).
  */
-static int8_t _find_free_slot(void)
+static void _pool_init(fn_pool_t *pool, uint8_t *buf, size_t size, uint16_t unit)
 {
-    int8_t i;
-    for (i = 0; i < FN_MAX_SESSIONS; i++) {
-        if (!_sessions[i].active) {
-            return i;
+    pool->next = buf;
+    pool->end = buf != NULL ? buf + size : NULL;
+    pool->free = NULL;
+    pool->size = unit;
+}
+
+/**
+ * Take a buffer from a pool (NULL if it is used up).
+ */
+static uint8_t *_pool_get(fn_pool_t *pool)
+{
+    uint8_t *buf;
+    
+    if (pool->free != NULL) {
+        buf = pool->free;
+        memcpy(&pool->free, buf, sizeof(uint8_t *));
+        return buf;
+    }
+    if (pool->next != NULL && (size_t)(pool->end - pool->next) >= pool->size) {
+        buf = pool->next;
+        pool->next += pool->size;
+        return buf;
+    }
+    return NULL;
+}
+
+/**
+ * Give a buffer back to its pool.
+ */
+static void _pool_put(fn_pool_t *pool, uint8_t *buf)
+{
+    memcpy(buf, &pool->free, sizeof(uint8_t *));
+    pool->free = buf;
+}
+#endif
+
+/**
+ * Give a session's buffers back to their pools. Writes still buffered
+ * are dropped.
+ */
+static void _release_buffers(int16_t slot)
+{
+#if FN_READ_AHEAD_BUFFERS > 0
+    if (_sessions[slot].ra_buf != NULL) {
+        _pool_put(&_ra_pool, _sessions[slot].ra_buf);
+    }
+#endif
+#if FN_WRITE_BUFFERS > 0
+    if (_sessions[slot].wb_buf != NULL) {
+        if (_sessions[slot].wb_len > 0) {
+            _wb_pending--;
         }
+        _pool_put(&_wb_pool, _sessions[slot].wb_buf);
     }
-    return -1;
+#endif
+    (void)slot;
+}
+
+/**
+ * Home slot of a handle. Devices hand out small numbers, so the table is
+ * mostly indexed directly by the low bits.
+ */
+static int16_t _home_slot(fn_handle_t handle)
+{
+    return (int16_t)((handle ^ (handle >> 8)) & SESSION_MASK);
 }
 
 /**
- * Find session by handle.
+ * Find session by handle: probe from its home slot up to an empty one.
  */
-static int8_t _find_session(fn_handle_t handle)
+static int16_t _find_session(fn_handle_t handle)
 {
-    int8_t i;
-    for (i = 0; i < FN_MAX_SESSIONS; i++) {
-        if (_sessions[i].active && _sessions[i].handle == handle) {
+    int16_t i;
+    uint16_t n;
+    
+    i = _home_slot(handle);
+    for (n = 0; n < FN_SESSION_TABLE_SIZE && _sessions[i].active; n++) {
+        if (_sessions[i].handle == handle) {
             return i;
         }
+        i = (i + 1) & SESSION_MASK;
     }
     return -1;
 }
 
+/**
+ * Add a session for a handle, cleared. A handle the device hands out again
+ * reuses its entry, which gives up the old session's buffers first.
+ * Returns -1 when FN_MAX_SESSIONS are open.
+ */
+static int16_t _add_session(fn_handle_t handle)
+{
+    int16_t i;
+    
+    i = _find_session(handle);
+    if (i >= 0) {
+        _release_buffers(i);
+    } else {
+        if (_session_count >= FN_MAX_SESSIONS) {
+            return -1;
+        }
+        i = _home_slot(handle);
+        while (_sessions[i].active) {
+            i = (i + 1) & SESSION_MASK;
+        }
+        _session_count++;
+    }
+    
+    memset(&_sessions[i], 0, sizeof(fn_session_t));
+    _sessions[i].active = 1;
+    _sessions[i].handle = handle;
+    return i;
+}
+
+/**
+ * Remove a session. Entries further along its probe run move back into
+ * the gap, so lookups never need to skip deleted slots.
+ */
+static void _remove_session(int16_t slot)
+{
+    int16_t j;
+    int16_t home;
+    
+    for (j = (slot + 1) & SESSION_MASK; j != slot && _sessions[j].active; j = (j + 1) & SESSION_MASK) {
+        /* The entry at j can fill the gap unless its home lies after the gap */
+        home = _home_slot(_sessions[j].handle);
+        if (((j - home) & SESSION_MASK) >= ((j - slot) & SESSION_MASK)) {
+            _sessions[slot] = _sessions[j];
+            slot = j;
+        }
+    }
+    _sessions[slot].active = 0;
+    _session_count--;
+}
+
+/**
+ * Find session by handle, for the rest of the library.
+ */
+fn_session_t *fn_session_find(fn_handle_t handle)
+{
+    int16_t slot;
+    
+    slot = _find_session(handle);
+    if (slot < 0) {
+        return NULL;
+    }
+    return &_sessions[slot];
+}
+
+/**
+ * Exchange a packet, unless an asynchronous operation owns the link.
+ */
+uint8_t fn_exchange(const uint8_t *request,
+                    uint16_t req_len,
+                    uint8_t *response,
+                    uint16_t resp_max,
+                    uint16_t *resp_len)
+{
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
+    }
+    return FN_TRANSPORT_EXCHANGE(request, req_len, response, resp_max, resp_len);
+}
+
+#ifdef FN_TRANSPORT_EXCHANGE_WIRE
+/**
+ * Exchange a SLIP-encoded packet, unless an asynchronous operation owns the link.
+ */
+uint8_t fn_exchange_wire(const uint8_t *wire,
+                         uint16_t wire_len,
+                         uint8_t *response,
+                         uint16_t resp_max,
+                         uint16_t *resp_len)
+{
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
+    }
+    return FN_TRANSPORT_EXCHANGE_WIRE(wire, wire_len, response, resp_max, resp_len);
+}
+#endif
+
+#ifdef FN_TRANSPORT_EXCHANGE_SG
+/**
+ * Exchange a packet given as segments, unless an asynchronous operation owns the link.
+ */
+uint8_t fn_exchange_sg(const fn_segment_t *segs,
+                       uint8_t count,
+                       uint8_t *response,
+                       uint16_t resp_max,
+                       uint16_t *resp_len)
+{
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
+    }
+    return FN_TRANSPORT_EXCHANGE_SG(segs, count, response, resp_max, resp_len);
+}
+#endif
+
 /**
  * Free a handle.
  */
 static void _free_handle(fn_handle_t handle)
 {
-    int8_t slot;
+    int16_t slot;
     
     if (handle == FN_INVALID_HANDLE) {
         return;
@@ -69,49 +352,252 @@ static void _free_handle(fn_handle_t handle)
     
     slot = _find_session(handle);
     if (slot >= 0) {
-        _sessions[slot].active = 0;
+        _release_buffers(slot);
+        _remove_session(slot);
+    }
+}
+
+/**
+ * Exchange the request in fn_req_buf, one attempt of a request that is
+ * sent again while retries remain. Until the last attempt, the transport
+ * may give up on the response early; a later attempt replaces it.
+ */
+static uint8_t _exchange_attempt(uint16_t req_len, uint16_t *resp_len, uint8_t retries)
+{
+    uint8_t result;
+    
+    fn_frame_damaged = 0;
+    fn_exchange_adaptive = (retries > 0);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, resp_len);
+    fn_exchange_adaptive = 0;
+    return result;
+}
+
+/**
+ * Whether an idempotent request should be sent again after this result:
+ * the response never arrived, or arrived damaged. Errors the device
+ * reports and failures of the link itself are final.
+ */
+static uint8_t _should_retransmit(uint8_t result)
+{
+    return result == FN_ERR_TIMEOUT || (result != FN_OK && fn_frame_damaged);
+}
+
+/* ============================================================================
+ * Transport Selection
+ * ============================================================================ */
+
+#ifndef FN_TRANSPORT_DIRECT
+
+#ifndef FN_HAVE_TRANSPORT_DEFAULT
+/* Single-transport platforms: wrap the direct-call functions */
+static const fn_transport_ops_t _platform_transport = {
+    FN_PLATFORM_NAME,
+    FN_TRANSPORT_DIRECT_MAX_FRAME,
+    FN_TRANSPORT_DIRECT_CAPS,
+    fn_transport_init,
+    fn_transport_ready,
+    fn_transport_exchange,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+#ifdef FN_TRANSPORT_DIRECT_WIRE
+    fn_transport_exchange_wire,
+#else
+    NULL,
+#endif
+    NULL,
+    NULL,
+    NULL
+};
+
+const fn_transport_ops_t *fn_transport_default(void)
+{
+    return &_platform_transport;
+}
+#endif
+
+uint8_t fn_transport_register(const fn_transport_ops_t *ops)
+{
+    if (_initialized) {
+        return FN_ERR_BUSY;
+    }
+    
+    if (ops == NULL || ops->init == NULL || ops->ready == NULL ||
+        ops->exchange == NULL || ops->max_frame < FN_HEADER_SIZE) {
+        return FN_ERR_INVALID;
+    }
+    
+    if ((ops->caps & FN_TRANSPORT_CAP_PIPELINE) &&
+        (ops->send == NULL || ops->recv == NULL)) {
+        return FN_ERR_INVALID;
     }
+    
+    if ((ops->caps & FN_TRANSPORT_CAP_ASYNC) &&
+        (ops->send == NULL || ops->poll == NULL)) {
+        return FN_ERR_INVALID;
+    }
+    
+    fn_transport = ops;
+    return FN_OK;
 }
 
+#endif /* FN_TRANSPORT_DIRECT */
+
 /* ============================================================================
  * Initialization
  * ============================================================================ */
 
-uint8_t fn_init(void)
+#if FN_MAX_FRAME_SIZE > FN_MAX_PACKET_SIZE
+/**
+ * Agree on a frame size larger than the default with the device.
+ * 
+ * Runs in default-sized frames. Devices that don't know the command
+ * answer with an error, or not at all, and the link keeps
+ * FN_MAX_PACKET_SIZE. The probe waits for the adaptive deadline, not the
+ * full timeout, so firmware that ignores it doesn't stall fn_init().
+ * 
+ * @param want  Largest frame the transport and our buffers can carry
+ * @return Frame size to use
+ */
+static uint16_t _negotiate_frame(uint16_t want)
+{
+    uint16_t req_len;
+    uint16_t resp_len;
+    uint16_t agreed;
+    uint8_t result;
+    
+    req_len = fn_build_frame_size_packet(fn_req_buf, want);
+    fn_exchange_adaptive = 1;
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    fn_exchange_adaptive = 0;
+    if (result == FN_OK) {
+        result = fn_parse_frame_size_response(fn_resp_buf, resp_len, &agreed);
+    }
+    if (result != FN_OK || agreed <= FN_MAX_PACKET_SIZE) {
+        return FN_MAX_PACKET_SIZE;
+    }
+    if (agreed > want) {
+        agreed = want;
+    }
+    
+    /* The transport sizes its buffers before the first large frame */
+    if (FN_TRANSPORT_SET_MAX_FRAME(agreed) != FN_OK) {
+        return FN_MAX_PACKET_SIZE;
+    }
+    return agreed;
+}
+#endif
+
+/**
+ * Largest frame a buffer of size bytes holds (frame lengths are 16-bit).
+ */
+static uint16_t _buffer_frame(uint32_t size)
+{
+    if (size > FN_FRAME_SIZE_LIMIT) {
+        return FN_FRAME_SIZE_LIMIT;
+    }
+    return (uint16_t)size;
+}
+
+uint8_t fn_init_ex(const fn_buffers_t *bufs)
 {
     uint8_t result;
-    int8_t i;
+    uint16_t limit;
+    uint16_t resp_frame;
+    uint16_t i;
     
     if (_initialized) {
         return FN_OK;
     }
     
-    for (i = 0; i < FN_MAX_SESSIONS; i++) {
+    if (bufs == NULL || bufs->req_buf == NULL || bufs->resp_buf == NULL ||
+        bufs->req_size < FN_MIN_BUFFER_SIZE || bufs->resp_size < FN_MIN_BUFFER_SIZE) {
+        return FN_ERR_INVALID;
+    }
+    
+    /* Frames (and so chunks) are limited to what both buffers hold */
+    limit = _buffer_frame(bufs->req_size);
+    resp_frame = _buffer_frame(bufs->resp_size);
+    if (resp_frame < limit) {
+        limit = resp_frame;
+    }
+    if (limit < FN_MIN_BUFFER_SIZE) {
+        return FN_ERR_INVALID;
+    }
+    
+    fn_req_buf = bufs->req_buf;
+    fn_resp_buf = bufs->resp_buf;
+    fn_wire_size = _buffer_frame(bufs->req_size);
+    if (bufs->resp_buf == bufs->req_buf + bufs->req_size) {
+        fn_wire_size = _buffer_frame((uint32_t)bufs->req_size + bufs->resp_size);
+    }
+    
+#if FN_READ_AHEAD_BUFFERS > 0
+    _pool_init(&_ra_pool, bufs->ra_buf, bufs->ra_size, FN_READ_AHEAD_SIZE);
+#endif
+#if FN_WRITE_BUFFERS > 0
+    _pool_init(&_wb_pool, bufs->wb_buf, bufs->wb_size, FN_WRITE_BUFFER_SIZE);
+    _wb_pending = 0;
+#endif
+    
+    for (i = 0; i < FN_SESSION_TABLE_SIZE; i++) {
         _sessions[i].active = 0;
     }
+    _session_count = 0;
+    _read_multi_ok = 1;
+    _poll_ok = 1;
+    
+#ifndef FN_TRANSPORT_DIRECT
+    if (fn_transport == &_null_transport) {
+        fn_transport = fn_transport_default();
+    }
+#endif
     
-    result = fn_transport_init();
+    result = FN_TRANSPORT_SET_BUFFER(bufs->xport_buf, bufs->xport_size);
+    if (result == FN_OK) {
+        result = FN_TRANSPORT_INIT();
+    }
     if (result != FN_OK) {
         return result;
     }
     
+    fn_max_frame = FN_TRANSPORT_MAX_FRAME();
+    if (fn_max_frame > limit) {
+        fn_max_frame = limit;
+    }
+    if (fn_max_frame > FN_MAX_PACKET_SIZE) {
+#if FN_MAX_FRAME_SIZE > FN_MAX_PACKET_SIZE
+        /* Fast links: ask for frames up to what both sides can buffer */
+        fn_max_frame = _negotiate_frame(fn_max_frame);
+#else
+        fn_max_frame = FN_MAX_PACKET_SIZE;
+#endif
+    }
+    
     _initialized = 1;
     return FN_OK;
 }
 
 uint8_t fn_is_ready(void)
 {
-    return fn_transport_ready();
+    return FN_TRANSPORT_READY();
+}
+
+uint16_t fn_max_chunk_size(void)
+{
+    if (!_initialized) {
+        return FN_MAX_CHUNK_SIZE;
+    }
+    return fn_max_frame - FN_READ_RESP_OVERHEAD;
 }
 
 /* ============================================================================
  * Network Operations
  * ============================================================================ */
 
-/* Static buffers for CC65 compatibility (reduces stack usage) */
-static uint8_t _req_buf[FN_MAX_PACKET_SIZE];
-static uint8_t _resp_buf[FN_MAX_PACKET_SIZE];
-
 uint8_t fn_open(fn_handle_t *handle, 
                 uint8_t method,
                 const char *url,
@@ -121,7 +607,7 @@ uint8_t fn_open(fn_handle_t *handle,
     uint16_t resp_len;
     uint8_t result;
     uint8_t open_flags;
-    int8_t slot;
+    int16_t slot;
     fn_handle_t resp_handle;
     uint8_t resp_flags;
     uint8_t resp_proto_flags;
@@ -149,37 +635,49 @@ uint8_t fn_open(fn_handle_t *handle,
         open_flags |= FN_OPEN_FLAG_ALLOW_EVICT;
     }
     
-    req_len = fn_build_open_packet(_req_buf, method, open_flags, url);
+    /*
+     * The device would allocate a handle we couldn't track. With eviction
+     * allowed it may instead hand back one of ours, so ask it anyway.
+     */
+    if (_session_count >= FN_MAX_SESSIONS && !(flags & FN_OPEN_ALLOW_EVICT)) {
+        return FN_ERR_NO_HANDLES;
+    }
+    
+    req_len = fn_build_open_packet(fn_req_buf, method, open_flags, url);
     if (req_len == 0) {
         return FN_ERR_INVALID;
     }
     
-    result = fn_transport_exchange(_req_buf, req_len, _resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
-    result = fn_parse_open_response(_resp_buf, resp_len, &resp_handle, &resp_flags, &resp_proto_flags);
+    result = fn_parse_open_response(fn_resp_buf, resp_len, &resp_handle, &resp_flags, &resp_proto_flags);
     if (result != FN_OK) {
         return result;
     }
     
-    /* Find a free session slot for tracking */
-    slot = _find_free_slot();
+    /* Track the device-assigned handle (room was checked before sending) */
+    slot = _add_session(resp_handle);
     if (slot < 0) {
-        /* No free slots - but device already allocated handle. Continue anyway. */
-        *handle = resp_handle;
-        return FN_OK;
+        /* A new handle despite eviction: don't leave it open on the device */
+        req_len = fn_build_close_packet(fn_req_buf, resp_handle);
+        fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
+        return FN_ERR_NO_HANDLES;
     }
-    
-    /* Store the device-assigned handle and mark session active */
     *handle = resp_handle;
-    _sessions[slot].active = 1;
-    _sessions[slot].handle = resp_handle;
     _sessions[slot].proto_flags = resp_proto_flags;
-    _sessions[slot].needs_body = 0;
-    _sessions[slot].write_offset = 0;
-    _sessions[slot].read_offset = 0;
+#if FN_READ_AHEAD_BUFFERS > 0
+    if (flags & FN_OPEN_READ_AHEAD) {
+        _sessions[slot].ra_buf = _pool_get(&_ra_pool);
+    }
+#endif
+#if FN_WRITE_BUFFERS > 0
+    if (flags & FN_OPEN_WRITE_BUFFER) {
+        _sessions[slot].wb_buf = _pool_get(&_wb_pool);
+    }
+#endif
     
     if (resp_flags & FN_OPEN_RESP_NEEDS_BODY) {
         _sessions[slot].needs_body = 1;
@@ -233,48 +731,74 @@ uint8_t fn_tcp_open(fn_handle_t *handle,
     return fn_open(handle, 0, _tcp_url, 0);
 }
 
-uint8_t fn_write(fn_handle_t handle,
-                 uint32_t offset,
-                 const uint8_t *data,
-                 uint16_t len,
-                 uint16_t *written)
+/**
+ * Send one WRITE request at the given offset, carrying the data in the
+ * given segments (no more than one frame holds). *written is what the
+ * device accepted; the caller advances the session's write offset.
+ */
+static uint8_t _write_frame(int16_t slot,
+                            uint32_t offset,
+                            const fn_segment_t *data,
+                            uint8_t count,
+                            uint16_t *written)
 {
+    fn_handle_t handle;
     uint16_t req_len;
     uint16_t resp_len;
     uint8_t result;
-    int8_t slot;
     uint8_t status;
+    uint8_t i;
     uint16_t data_offset;
     uint16_t data_len;
+#ifdef FN_TRANSPORT_EXCHANGE_WIRE
+    uint16_t wire_start;
+#endif
+#ifdef FN_TRANSPORT_EXCHANGE_SG
+    fn_segment_t segs[1 + FN_MAX_WRITEV_SEGMENTS];
+#endif
     
-    if (!_initialized) {
-        return FN_ERR_INVALID;
-    }
-    
-    if (handle == FN_INVALID_HANDLE) {
-        return FN_ERR_INVALID;
-    }
+    handle = _sessions[slot].handle;
     
-    slot = _find_session(handle);
-    if (slot < 0) {
-        return FN_ERR_NOT_FOUND;
+    /*
+     * Transports that gather segments get the head from the request buffer
+     * and the data from where the caller keeps it, so the data is never
+     * copied. Transports that take SLIP frames get the data escaped and
+     * summed on its way into the request buffer. If escaping makes it too
+     * big for the buffer, the plain packet is sent instead.
+     */
+    req_len = 0;
+#ifdef FN_TRANSPORT_EXCHANGE_SG
+    if (FN_TRANSPORT_HAS_SG()) {
+        segs[0].data = fn_req_buf;
+        segs[0].len = fn_build_write_head(fn_req_buf, handle, offset, data, count);
+        memcpy(segs + 1, data, count * sizeof(fn_segment_t));
+        req_len = segs[0].len;
+        result = fn_exchange_sg(segs, 1 + count, fn_resp_buf, fn_max_frame, &resp_len);
     }
-    
-    if (offset != _sessions[slot].write_offset) {
-        return FN_ERR_INVALID;
+#endif
+#ifdef FN_TRANSPORT_EXCHANGE_WIRE
+    if (req_len == 0 && FN_TRANSPORT_HAS_WIRE()) {
+        req_len = fn_build_write_wire(fn_req_buf, fn_wire_size, &wire_start, handle, offset, data, count);
+        if (req_len != 0) {
+            result = fn_exchange_wire(fn_req_buf + wire_start, req_len, fn_resp_buf, fn_max_frame, &resp_len);
+        }
     }
-    
-    req_len = fn_build_write_packet(_req_buf, handle, offset, data, len);
+#endif
     if (req_len == 0) {
-        return FN_ERR_INVALID;
+        req_len = fn_build_write_head(fn_req_buf, handle, offset, data, count);
+        for (i = 0; i < count; i++) {
+            if (data[i].len > 0) {
+                memcpy(fn_req_buf + req_len, data[i].data, data[i].len);
+                req_len += data[i].len;
+            }
+        }
+        result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     }
-    
-    result = fn_transport_exchange(_req_buf, req_len, _resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
     if (result != FN_OK) {
         return result;
     }
     
-    result = fn_parse_response_header(_resp_buf, resp_len, &status, &data_offset, &data_len);
+    result = fn_parse_response_header(fn_resp_buf, resp_len, &status, &data_offset, &data_len);
     if (result != FN_OK) {
         return result;
     }
@@ -283,56 +807,446 @@ uint8_t fn_write(fn_handle_t handle,
         return status;
     }
     
-    if (data_len >= 12 && written != NULL) {
-        *written = _resp_buf[data_offset + 10] | (_resp_buf[data_offset + 11] << 8);
-        _sessions[slot].write_offset += *written;
-    } else if (written != NULL) {
-        *written = 0;
+    *written = 0;
+    if (data_len >= 12) {
+        *written = fn_resp_buf[data_offset + 10] | (fn_resp_buf[data_offset + 11] << 8);
     }
     
     return FN_OK;
 }
 
-uint8_t fn_read(fn_handle_t handle,
-                uint32_t offset,
-                uint8_t *buf,
-                uint16_t max_len,
-                uint16_t *bytes_read,
-                uint8_t *flags)
+/**
+ * Send a session's buffered writes, which end at its write offset.
+ * FN_ERR_BUSY if the device took none of them, or if an asynchronous
+ * operation holds the link (that one doesn't count as a failure). A
+ * failure is kept in the session's wb_error, for fn_poll() to report and
+ * so _flush_stale() leaves the session alone until a flush succeeds.
+ */
+static uint8_t _flush(int16_t slot)
 {
-    uint16_t req_len;
-    uint16_t resp_len;
+#if FN_WRITE_BUFFERS > 0
+    fn_segment_t seg;
+    uint16_t len;
+    uint16_t sent;
     uint8_t result;
-    int8_t slot;
-    fn_handle_t resp_handle;
-    uint32_t offset_echo;
     
-    if (!_initialized) {
-        return FN_ERR_INVALID;
+    if (_sessions[slot].wb_len == 0) {
+        return FN_OK;
     }
     
-    if (handle == FN_INVALID_HANDLE || buf == NULL || bytes_read == NULL) {
-        return FN_ERR_INVALID;
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
     }
     
-    slot = _find_session(handle);
-    if (slot < 0) {
-        return FN_ERR_NOT_FOUND;
+    while (_sessions[slot].wb_len > 0) {
+        len = _sessions[slot].wb_len;
+        if (len > fn_max_frame - FN_WRITE_REQ_OVERHEAD) {
+            len = fn_max_frame - FN_WRITE_REQ_OVERHEAD;
+        }
+        seg.data = _sessions[slot].wb_buf;
+        seg.len = len;
+        result = _write_frame(slot,
+                              _sessions[slot].write_offset - _sessions[slot].wb_len,
+                              &seg, 1, &sent);
+        if (result == FN_OK && sent == 0) {
+            result = FN_ERR_BUSY;
+        }
+        if (result != FN_OK) {
+            _sessions[slot].wb_error = result;
+            return result;
+        }
+        if (sent > len) {
+            sent = len;
+        }
+        _sessions[slot].wb_len -= sent;
+        memmove(_sessions[slot].wb_buf, _sessions[slot].wb_buf + sent, _sessions[slot].wb_len);
     }
+    _sessions[slot].wb_error = FN_OK;
+    _wb_pending--;
+#else
+    (void)slot;
+#endif
     
-    req_len = fn_build_read_packet(_req_buf, handle, offset, max_len);
-    if (req_len == 0) {
-        return FN_ERR_INVALID;
+    return FN_OK;
+}
+
+/**
+ * Flush buffered writes that have waited longer than the flush delay.
+ * Errors are left for the next call that sends the session's buffer, or
+ * fn_poll(), to report; until then the session is skipped, so a failing
+ * session doesn't cost an exchange on every call for other handles.
+ */
+static void _flush_stale(void)
+{
+#if FN_WRITE_BUFFERS > 0
+    uint16_t now;
+    int16_t slot;
+    
+    if (_wb_pending == 0 || _flush_delay == 0) {
+        return;
     }
     
-    result = fn_transport_exchange(_req_buf, req_len, _resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
-    if (result != FN_OK) {
-        return result;
+    now = FN_PLATFORM_MS();
+    for (slot = 0; slot < FN_SESSION_TABLE_SIZE; slot++) {
+        if (_sessions[slot].active &&
+            _sessions[slot].wb_len > 0 &&
+            _sessions[slot].wb_error == FN_OK &&
+            (uint16_t)(now - _sessions[slot].wb_time) >= _flush_delay) {
+            _flush(slot);
+        }
     }
+#endif
+}
+
+uint8_t fn_flush(fn_handle_t handle)
+{
+    int16_t slot;
     
-    result = fn_parse_read_response(_resp_buf, resp_len, &resp_handle, &offset_echo, flags, buf, max_len, bytes_read);
-    if (result != FN_OK) {
-        return result;
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (handle == FN_INVALID_HANDLE) {
+        return FN_ERR_INVALID;
+    }
+    
+    slot = _find_session(handle);
+    if (slot < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    return _flush(slot);
+}
+
+void fn_set_flush_delay(uint16_t ms)
+{
+    _flush_delay = ms;
+}
+
+uint8_t fn_write(fn_handle_t handle,
+                 uint32_t offset,
+                 const uint8_t *data,
+                 uint16_t len,
+                 uint16_t *written)
+{
+    fn_segment_t seg;
+#if FN_WRITE_BUFFERS > 0
+    uint16_t chunk;
+#endif
+    uint16_t count;
+    uint8_t result;
+    int16_t slot;
+    
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (handle == FN_INVALID_HANDLE || (data == NULL && len > 0)) {
+        return FN_ERR_INVALID;
+    }
+    
+    _flush_stale();
+    
+    slot = _find_session(handle);
+    if (slot < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    if (offset != _sessions[slot].write_offset) {
+        return FN_ERR_INVALID;
+    }
+    
+#if FN_WRITE_BUFFERS > 0
+    chunk = fn_max_frame - FN_WRITE_REQ_OVERHEAD;
+    if (chunk > FN_WRITE_BUFFER_SIZE) {
+        chunk = FN_WRITE_BUFFER_SIZE;
+    }
+    
+    if (_sessions[slot].wb_buf != NULL && len > 0 && len < chunk) {
+        /* Small write: keep it, sending what was kept first if it won't fit */
+        if (_sessions[slot].wb_len + len > chunk) {
+            result = _flush(slot);
+            if (result != FN_OK) {
+                return result;
+            }
+        }
+        if (_sessions[slot].wb_len == 0) {
+            _sessions[slot].wb_time = FN_PLATFORM_MS();
+            _wb_pending++;
+        }
+        memcpy(_sessions[slot].wb_buf + _sessions[slot].wb_len, data, len);
+        _sessions[slot].wb_len += len;
+        _sessions[slot].write_offset += len;
+        if (written != NULL) {
+            *written = len;
+        }
+        return FN_OK;
+    }
+    
+    if (_sessions[slot].wb_len > 0) {
+        result = _flush(slot);
+        if (result != FN_OK) {
+            return result;
+        }
+    }
+#endif
+    
+    /* Send no more than one frame; *written tells the caller how much went */
+    if (len > fn_max_frame - FN_WRITE_REQ_OVERHEAD) {
+        len = fn_max_frame - FN_WRITE_REQ_OVERHEAD;
+    }
+    
+    seg.data = data;
+    seg.len = len;
+    result = _write_frame(slot, offset, &seg, 1, &count);
+    if (result == FN_OK) {
+        _sessions[slot].write_offset += count;
+        if (written != NULL) {
+            *written = count;
+        }
+    }
+    
+    return result;
+}
+
+uint8_t fn_writev(fn_handle_t handle,
+                  const fn_iovec_t *iov,
+                  uint8_t iovcnt,
+                  uint32_t *written)
+{
+    fn_segment_t segs[FN_MAX_WRITEV_SEGMENTS];
+    uint16_t chunk;
+    uint16_t room;
+    uint16_t pos;
+    uint16_t n;
+    uint16_t sent;
+    uint8_t count;
+    uint8_t i;
+    uint8_t result;
+    int16_t slot;
+    
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (handle == FN_INVALID_HANDLE || (iov == NULL && iovcnt > 0) || written == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].base == NULL && iov[i].len > 0) {
+            return FN_ERR_INVALID;
+        }
+    }
+    
+    slot = _find_session(handle);
+    if (slot < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    result = _flush(slot);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    *written = 0;
+    chunk = fn_max_frame - FN_WRITE_REQ_OVERHEAD;
+    i = 0;
+    pos = 0;
+    
+    for (;;) {
+        /* Gather as much as one frame carries, splitting a buffer if need be */
+        count = 0;
+        room = chunk;
+        while (i < iovcnt && count < FN_MAX_WRITEV_SEGMENTS && room > 0) {
+            n = iov[i].len - pos;
+            if (n > room) {
+                n = room;
+            }
+            if (n > 0) {
+                segs[count].data = iov[i].base + pos;
+                segs[count].len = n;
+                count++;
+                room -= n;
+                pos += n;
+            }
+            if (pos == iov[i].len) {
+                i++;
+                pos = 0;
+            }
+        }
+        
+        if (count == 0) {
+            break;
+        }
+        
+        result = _write_frame(slot, _sessions[slot].write_offset, segs, count, &sent);
+        if (result != FN_OK) {
+            return result;
+        }
+        _sessions[slot].write_offset += sent;
+        *written += sent;
+        
+        /* The device took less (e.g. a full TCP window): let the caller retry */
+        if (sent < chunk - room) {
+            break;
+        }
+    }
+    
+    return FN_OK;
+}
+
+/**
+ * Read from the device into the response buffer: *data points at the
+ * data in fn_resp_buf. FN_ERR_IO if the reply is for another handle or
+ * offset.
+ */
+static uint8_t _read_device(int16_t slot,
+                            uint32_t offset,
+                            uint16_t max_len,
+                            const uint8_t **data,
+                            uint16_t *bytes_read,
+                            uint8_t *flags)
+{
+    uint16_t req_len;
+    uint16_t resp_len;
+    uint8_t result;
+    fn_handle_t handle;
+    fn_handle_t resp_handle;
+    uint32_t offset_echo;
+    uint8_t retries;
+    
+    handle = _sessions[slot].handle;
+    
+    /* Ask for no more than one response frame can carry */
+    if (max_len > fn_max_frame - FN_READ_RESP_OVERHEAD) {
+        max_len = fn_max_frame - FN_READ_RESP_OVERHEAD;
+    }
+    
+    req_len = fn_build_read_packet(fn_req_buf, handle, offset, max_len);
+    if (req_len == 0) {
+        return FN_ERR_INVALID;
+    }
+    
+    /*
+     * A READ at an offset can be sent again if the response is lost or
+     * corrupted. Sequential protocols consume data on the device, so their
+     * reads are never repeated.
+     */
+    retries = (_sessions[slot].proto_flags & FN_PROTO_FLAG_SEQUENTIAL_READ) ? 0 : FN_TRANSPORT_RETRIES;
+    for (;;) {
+        result = _exchange_attempt(req_len, &resp_len, retries);
+        if (result == FN_OK) {
+            result = fn_parse_read_view(fn_resp_buf, resp_len, &resp_handle, &offset_echo, flags, data, bytes_read);
+        }
+        
+        /* A reply for another session or offset isn't this read's data */
+        if (result == FN_OK && (resp_handle != handle || offset_echo != offset)) {
+            result = FN_ERR_IO;
+        }
+        if (retries == 0 || !_should_retransmit(result)) {
+            break;
+        }
+        retries--;
+    }
+    return result;
+}
+
+#if FN_READ_AHEAD_BUFFERS > 0
+/**
+ * Read from the session's read-ahead buffer, filling it first if the
+ * offset isn't in it: *data points at the data in the buffer.
+ */
+static uint8_t _read_ahead(int16_t slot,
+                           uint32_t offset,
+                           uint16_t max_len,
+                           const uint8_t **data,
+                           uint16_t *bytes_read,
+                           uint8_t *flags)
+{
+    const uint8_t *src;
+    uint32_t pos;
+    uint16_t got;
+    uint8_t result;
+    
+    pos = offset - _sessions[slot].ra_offset;
+    if (pos >= _sessions[slot].ra_len) {
+        result = _read_device(slot, offset, FN_READ_AHEAD_SIZE, &src, &got, flags);
+        if (result != FN_OK) {
+            return result;
+        }
+        if (got > FN_READ_AHEAD_SIZE) {
+            got = FN_READ_AHEAD_SIZE;
+            *flags = 0;
+        }
+        memcpy(_sessions[slot].ra_buf, src, got);
+        _sessions[slot].ra_offset = offset;
+        _sessions[slot].ra_len = got;
+        _sessions[slot].ra_flags = *flags & FN_READ_EOF;
+        pos = 0;
+    }
+    
+    *data = _sessions[slot].ra_buf + (uint16_t)pos;
+    *bytes_read = _sessions[slot].ra_len - (uint16_t)pos;
+    *flags = _sessions[slot].ra_flags;
+    if (*bytes_read > max_len) {
+        *bytes_read = max_len;
+        *flags = 0;
+    }
+    return FN_OK;
+}
+#endif
+
+/**
+ * Read from a session: *data points at the data in fn_resp_buf or the
+ * session's read-ahead buffer.
+ */
+static uint8_t _read(fn_handle_t handle,
+                     uint32_t offset,
+                     uint16_t max_len,
+                     const uint8_t **data,
+                     uint16_t *bytes_read,
+                     uint8_t *flags)
+{
+    uint8_t result;
+    int16_t slot;
+    
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (handle == FN_INVALID_HANDLE || bytes_read == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    _flush_stale();
+    
+    slot = _find_session(handle);
+    if (slot < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    /* Writes kept in the session's buffer go before anything is read */
+    result = _flush(slot);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    /*
+     * Small reads go through the read-ahead buffer, as do reads of data
+     * already in it. Larger ones are as quick straight from the device.
+     */
+#if FN_READ_AHEAD_BUFFERS > 0
+    if (_sessions[slot].ra_buf != NULL &&
+        (max_len < FN_READ_AHEAD_SIZE || offset - _sessions[slot].ra_offset < _sessions[slot].ra_len)) {
+        result = _read_ahead(slot, offset, max_len, data, bytes_read, flags);
+    } else
+#endif
+    {
+        result = _read_device(slot, offset, max_len, data, bytes_read, flags);
+    }
+    if (result != FN_OK) {
+        return result;
     }
     
     /* Update read offset for sequential protocols (TCP, TLS) */
@@ -343,6 +1257,593 @@ uint8_t fn_read(fn_handle_t handle,
     return FN_OK;
 }
 
+uint8_t fn_read(fn_handle_t handle,
+                uint32_t offset,
+                uint8_t *buf,
+                uint16_t max_len,
+                uint16_t *bytes_read,
+                uint8_t *flags)
+{
+    const uint8_t *data;
+    uint16_t copy_len;
+    uint8_t result;
+    
+    if (buf == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    result = _read(handle, offset, max_len, &data, bytes_read, flags);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    copy_len = *bytes_read;
+    if (copy_len > max_len) {
+        copy_len = max_len;
+    }
+    memcpy(buf, data, copy_len);
+    
+    return FN_OK;
+}
+
+uint8_t fn_read_view(fn_handle_t handle,
+                     uint32_t offset,
+                     uint16_t max_len,
+                     const uint8_t **data,
+                     uint16_t *bytes_read,
+                     uint8_t *flags)
+{
+    if (data == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    return _read(handle, offset, max_len, data, bytes_read, flags);
+}
+
+uint8_t fn_readv(fn_handle_t handle,
+                 uint32_t offset,
+                 const fn_iovec_t *iov,
+                 uint8_t iovcnt,
+                 uint32_t *bytes_read,
+                 uint8_t *flags)
+{
+    const uint8_t *data;
+    uint32_t left;
+    uint16_t want;
+    uint16_t got;
+    uint16_t pos;
+    uint16_t n;
+    uint8_t i;
+    uint8_t result;
+    uint8_t read_flags;
+    int16_t slot;
+    
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (handle == FN_INVALID_HANDLE || (iov == NULL && iovcnt > 0) || bytes_read == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    left = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].base == NULL && iov[i].len > 0) {
+            return FN_ERR_INVALID;
+        }
+        left += iov[i].len;
+    }
+    
+    slot = _find_session(handle);
+    if (slot < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    *bytes_read = 0;
+    read_flags = 0;
+    result = FN_OK;
+    i = 0;
+    pos = 0;
+    
+    while (left > 0) {
+        want = fn_max_frame - FN_READ_RESP_OVERHEAD;
+        if (want > left) {
+            want = (uint16_t)left;
+        }
+        
+        result = _read(handle, offset + *bytes_read, want, &data, &got, &read_flags);
+        if (result != FN_OK) {
+            break;
+        }
+        if (got > want) {
+            got = want;
+        }
+        
+        *bytes_read += got;
+        left -= got;
+        
+        /* Scatter the data across the caller's buffers */
+        n = got;
+        while (n > 0) {
+            if (iov[i].len - pos < n) {
+                memcpy(iov[i].base + pos, data, iov[i].len - pos);
+                data += iov[i].len - pos;
+                n -= iov[i].len - pos;
+                i++;
+                pos = 0;
+            } else {
+                memcpy(iov[i].base + pos, data, n);
+                pos += n;
+                n = 0;
+            }
+        }
+        
+        /* End of data, or nothing more yet */
+        if ((read_flags & FN_READ_EOF) || got < want) {
+            break;
+        }
+    }
+    
+    if (flags != NULL) {
+        *flags = read_flags;
+    }
+    
+    if (result == FN_ERR_NOT_READY && *bytes_read > 0) {
+        return FN_OK;
+    }
+    return result;
+}
+
+#ifndef FN_TRANSPORT_DIRECT
+/** Requests in flight: start (relative to the read) and size, oldest first */
+static uint32_t _pipe_pos[FN_MAX_PIPELINE_DEPTH];
+static uint16_t _pipe_len[FN_MAX_PIPELINE_DEPTH];
+
+/**
+ * Pipelined body of fn_read_pipelined().
+ * 
+ * The device answers requests in the order it receives them, so each
+ * response belongs to the oldest request in flight; the handle and offset
+ * a READ response echoes confirm the match. Only a response that continues
+ * the data received so far is accepted. After a short read the request
+ * position is rewound, and responses already in flight past it are dropped.
+ */
+static uint8_t _read_pipelined(fn_handle_t handle,
+                               uint32_t offset,
+                               uint8_t *buf,
+                               uint32_t len,
+                               uint8_t depth,
+                               uint32_t *bytes_read,
+                               uint8_t *flags)
+{
+    uint16_t chunk;
+    uint32_t next;
+    uint32_t done;
+    uint32_t pos;
+    uint16_t want;
+    uint16_t n;
+    uint16_t req_len;
+    uint16_t resp_len;
+    uint8_t head;
+    uint8_t count;
+    uint8_t tail;
+    uint8_t stop;
+    uint8_t result;
+    uint8_t r;
+    fn_handle_t resp_handle;
+    uint32_t offset_echo;
+    uint8_t resp_flags;
+    
+    chunk = fn_max_frame - FN_READ_RESP_OVERHEAD;
+    next = 0;
+    done = 0;
+    head = 0;
+    count = 0;
+    stop = 0;
+    result = FN_OK;
+    
+    /* Responses read from here on must answer these requests */
+    FN_TRANSPORT_DISCARD();
+    
+    for (;;) {
+        /* Keep the window full */
+        while (!stop && count < depth && next < len) {
+            n = (len - next > chunk) ? chunk : (uint16_t)(len - next);
+            
+            req_len = fn_build_read_packet(fn_req_buf, handle, offset + next, n);
+            r = FN_TRANSPORT_SEND(fn_req_buf, req_len);
+            if (r != FN_OK) {
+                result = r;
+                stop = 1;
+                break;
+            }
+            
+            tail = (head + count) % FN_MAX_PIPELINE_DEPTH;
+            _pipe_pos[tail] = next;
+            _pipe_len[tail] = n;
+            count++;
+            next += n;
+        }
+        
+        if (count == 0) {
+            break;
+        }
+        
+        r = FN_TRANSPORT_RECV(fn_resp_buf, fn_max_frame, &resp_len);
+        if (r != FN_OK) {
+            /* The next exchange discards whatever is still in flight */
+            result = r;
+            break;
+        }
+        
+        pos = _pipe_pos[head];
+        want = _pipe_len[head];
+        head = (head + 1) % FN_MAX_PIPELINE_DEPTH;
+        count--;
+        
+        if (stop || pos != done) {
+            /* Draining after an error or EOF, or stale after a short read */
+            continue;
+        }
+        
+        r = fn_parse_read_response(fn_resp_buf, resp_len, &resp_handle, &offset_echo,
+                                   &resp_flags, buf + pos, want, &n);
+        if (r == FN_OK && (resp_handle != handle || offset_echo != offset + pos)) {
+            r = FN_ERR_IO;
+        }
+        if (r != FN_OK) {
+            result = r;
+            stop = 1;
+            continue;
+        }
+        
+        if (n > want) {
+            n = want;
+        }
+        done += n;
+        
+        if (resp_flags & FN_READ_EOF) {
+            *flags |= FN_READ_EOF;
+            stop = 1;
+        } else if (n == 0) {
+            stop = 1;           /* Nothing more available yet */
+        } else if (n < want) {
+            next = done;        /* Ask again for the rest */
+        }
+    }
+    
+    *bytes_read = done;
+    
+    if (result == FN_ERR_NOT_READY && done > 0) {
+        result = FN_OK;
+    }
+    return result;
+}
+#endif
+
+uint8_t fn_read_pipelined(fn_handle_t handle,
+                          uint32_t offset,
+                          uint8_t *buf,
+                          uint32_t len,
+                          uint8_t depth,
+                          uint32_t *bytes_read,
+                          uint8_t *flags)
+{
+    uint8_t result;
+    int16_t slot;
+    uint32_t done;
+    uint16_t want;
+    uint16_t n;
+    
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (handle == FN_INVALID_HANDLE || buf == NULL || bytes_read == NULL || flags == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    slot = _find_session(handle);
+    if (slot < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    *bytes_read = 0;
+    *flags = 0;
+    
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
+    }
+    
+    result = _flush(slot);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    if (depth > FN_MAX_PIPELINE_DEPTH) {
+        depth = FN_MAX_PIPELINE_DEPTH;
+    }
+    
+#ifndef FN_TRANSPORT_DIRECT
+    /* Sequential protocols can't ask for an offset before the last arrives */
+    if (depth > 1 && (FN_TRANSPORT_CAPS() & FN_TRANSPORT_CAP_PIPELINE) &&
+        !(_sessions[slot].proto_flags & FN_PROTO_FLAG_SEQUENTIAL_READ)) {
+        return _read_pipelined(handle, offset, buf, len, depth, bytes_read, flags);
+    }
+#endif
+    
+    /* One request at a time */
+    done = 0;
+    while (done < len) {
+        want = (len - done > 0xFFFF) ? 0xFFFF : (uint16_t)(len - done);
+        result = fn_read(handle, offset + done, buf + done, want, &n, flags);
+        if (result != FN_OK) {
+            *bytes_read = done;
+            if (result == FN_ERR_NOT_READY && done > 0) {
+                result = FN_OK;
+            }
+            return result;
+        }
+        
+        done += n;
+        if (n == 0 || (*flags & FN_READ_EOF)) {
+            break;
+        }
+    }
+    
+    *bytes_read = done;
+    return FN_OK;
+}
+
+/**
+ * Read an fn_read_multi() entry on its own.
+ */
+static void _read_one(fn_read_multi_t *rd)
+{
+    const uint8_t *data;
+    
+    rd->result = _read(rd->handle, rd->offset, rd->len, &data, &rd->bytes_read, &rd->flags);
+    if (rd->result != FN_OK) {
+        rd->bytes_read = 0;
+        return;
+    }
+    if (rd->bytes_read > rd->len) {
+        rd->bytes_read = rd->len;
+    }
+    memcpy(rd->buf, data, rd->bytes_read);
+}
+
+/**
+ * Send the READ_MULTI request for the n entries gathered, and hand each
+ * result to its entry. Results for the entries in fill go to their
+ * sessions' read-ahead buffers first. Entries with no result, or with a
+ * result for another offset, are left FN_ERR_IO.
+ */
+static uint8_t _read_multi_batch(fn_read_multi_t *reads, uint8_t n, uint8_t fill, uint8_t retries)
+{
+    fn_read_multi_t *rd;
+    const uint8_t *data;
+    uint16_t req_len;
+    uint16_t resp_len;
+    uint16_t pos;
+    uint16_t got;
+    uint32_t resp_offset;
+    fn_handle_t resp_handle;
+    uint8_t results;
+    uint8_t status;
+    uint8_t flags;
+    uint8_t done;
+    uint8_t result;
+    uint8_t i;
+    uint8_t j;
+    int16_t slot;
+    
+    req_len = fn_build_read_multi_packet(fn_req_buf, _multi_reqs, n);
+    if (req_len == 0) {
+        return FN_ERR_INVALID;
+    }
+    
+    for (;;) {
+        result = _exchange_attempt(req_len, &resp_len, retries);
+        if (result == FN_OK) {
+            result = fn_parse_read_multi_response(fn_resp_buf, resp_len, &results, &pos);
+        }
+        if (retries == 0 || !_should_retransmit(result)) {
+            break;
+        }
+        retries--;
+    }
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    /* Results are matched by handle, a handle listed twice in turn */
+    done = 0;
+    for (i = 0; i < results; i++) {
+        result = fn_parse_read_multi_entry(fn_resp_buf, resp_len, &pos, &resp_handle, &status, &flags,
+                                           &resp_offset, &data, &got);
+        if (result != FN_OK) {
+            return result;
+        }
+        for (j = 0; j < n; j++) {
+            if (!(done & (1 << j)) && _multi_reqs[j].handle == resp_handle) {
+                break;
+            }
+        }
+        if (j == n) {
+            continue;
+        }
+        done |= 1 << j;
+        
+        rd = &reads[_multi_index[j]];
+        rd->result = status;
+        if (status != FN_OK) {
+            continue;
+        }
+        if (resp_offset != _multi_reqs[j].offset) {
+            rd->result = FN_ERR_IO;
+            continue;
+        }
+        if (got > _multi_reqs[j].max_bytes) {
+            got = _multi_reqs[j].max_bytes;
+        }
+        slot = _find_session(resp_handle);
+        if (slot < 0) {
+            continue;
+        }
+#if FN_READ_AHEAD_BUFFERS > 0
+        if (fill & (1 << j)) {
+            memcpy(_sessions[slot].ra_buf, data, got);
+            _sessions[slot].ra_offset = _multi_reqs[j].offset;
+            _sessions[slot].ra_len = got;
+            _sessions[slot].ra_flags = flags & FN_READ_EOF;
+            data = _sessions[slot].ra_buf;
+            if (got > rd->len) {
+                got = rd->len;
+                flags = 0;
+            }
+        }
+#else
+        (void)fill;
+#endif
+        memcpy(rd->buf, data, got);
+        rd->bytes_read = got;
+        rd->flags = flags;
+        
+        /* Update read offset for sequential protocols (TCP, TLS) */
+        if (_sessions[slot].proto_flags & FN_PROTO_FLAG_SEQUENTIAL_READ) {
+            _sessions[slot].read_offset += got;
+        }
+    }
+    
+    return FN_OK;
+}
+
+uint8_t fn_read_multi(fn_read_multi_t *reads, uint8_t count)
+{
+    fn_read_multi_t *rd;
+    uint16_t budget;
+    uint16_t want;
+    uint8_t retries;
+    uint8_t result;
+    uint8_t fill;
+    uint8_t n;
+    uint8_t i;
+    int16_t slot;
+    
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (reads == NULL && count > 0) {
+        return FN_ERR_INVALID;
+    }
+    
+    for (i = 0; i < count; i++) {
+        if (reads[i].buf == NULL && reads[i].len > 0) {
+            return FN_ERR_INVALID;
+        }
+    }
+    
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
+    }
+    
+    for (i = 0; i < count; i++) {
+        reads[i].bytes_read = 0;
+        reads[i].flags = 0;
+        reads[i].result = FN_ERR_IO;
+    }
+    
+    _flush_stale();
+    
+    i = 0;
+    while (i < count) {
+        /* Gather sessions until the response frame is shared out */
+        n = 0;
+        fill = 0;
+        budget = fn_max_frame - FN_READ_MULTI_RESP_OVERHEAD;
+        retries = FN_TRANSPORT_RETRIES;
+        while (i < count && n < FN_MAX_READ_MULTI && budget > FN_READ_MULTI_ENTRY_SIZE) {
+            rd = &reads[i++];
+            
+            slot = _find_session(rd->handle);
+            if (rd->handle == FN_INVALID_HANDLE || slot < 0) {
+                rd->result = FN_ERR_NOT_FOUND;
+                continue;
+            }
+            
+            rd->result = _flush(slot);
+            if (rd->result != FN_OK) {
+                continue;
+            }
+            
+            if (!_read_multi_ok) {
+                _read_one(rd);
+                continue;
+            }
+            
+#if FN_READ_AHEAD_BUFFERS > 0
+            /* Data already in the read-ahead buffer needs no exchange */
+            if (_sessions[slot].ra_buf != NULL &&
+                rd->offset - _sessions[slot].ra_offset < _sessions[slot].ra_len) {
+                _read_one(rd);
+                continue;
+            }
+#endif
+            
+            budget -= FN_READ_MULTI_ENTRY_SIZE;
+            want = rd->len;
+#if FN_READ_AHEAD_BUFFERS > 0
+            /* Small reads fill the read-ahead buffer, as fn_read() would */
+            if (_sessions[slot].ra_buf != NULL && want < FN_READ_AHEAD_SIZE) {
+                want = FN_READ_AHEAD_SIZE;
+                fill |= 1 << n;
+            }
+#endif
+            if (want > budget) {
+                want = budget;
+            }
+            budget -= want;
+            
+            /* Sequential protocols consume data on the device: never repeat */
+            if (_sessions[slot].proto_flags & FN_PROTO_FLAG_SEQUENTIAL_READ) {
+                retries = 0;
+            }
+            
+            _multi_reqs[n].handle = rd->handle;
+            _multi_reqs[n].offset = rd->offset;
+            _multi_reqs[n].max_bytes = want;
+            _multi_index[n] = i - 1;
+            n++;
+        }
+        
+        if (n == 0) {
+            continue;
+        }
+        
+        result = _read_multi_batch(reads, n, fill, retries);
+        if (result == FN_ERR_UNSUPPORTED) {
+            /* Read this batch, and the rest, one session at a time */
+            _read_multi_ok = 0;
+            while (n > 0) {
+                _read_one(&reads[_multi_index[--n]]);
+            }
+            continue;
+        }
+        if (result != FN_OK) {
+            return result;
+        }
+    }
+    
+    for (i = 0; i < count; i++) {
+        if (reads[i].result == FN_OK) {
+            return FN_OK;
+        }
+    }
+    return FN_ERR_NOT_READY;
+}
+
 uint8_t fn_info(fn_handle_t handle,
                 uint16_t *http_status,
                 uint32_t *content_length,
@@ -351,8 +1852,9 @@ uint8_t fn_info(fn_handle_t handle,
     uint16_t req_len;
     uint16_t resp_len;
     uint8_t result;
-    int8_t slot;
+    int16_t slot;
     fn_handle_t resp_handle;
+    uint8_t retries;
     
     if (!_initialized) {
         return FN_ERR_INVALID;
@@ -367,26 +1869,208 @@ uint8_t fn_info(fn_handle_t handle,
         return FN_ERR_NOT_FOUND;
     }
     
-    req_len = fn_build_info_packet(_req_buf, handle);
+    result = _flush(slot);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    req_len = fn_build_info_packet(fn_req_buf, handle);
+    if (req_len == 0) {
+        return FN_ERR_INVALID;
+    }
+    
+    /* INFO has no side effects, so a lost or corrupted response is retried */
+    retries = FN_TRANSPORT_RETRIES;
+    for (;;) {
+        result = _exchange_attempt(req_len, &resp_len, retries);
+        if (result == FN_OK) {
+            result = fn_parse_info_response(fn_resp_buf, resp_len, &resp_handle, http_status, content_length, flags);
+        }
+        if (retries == 0 || !_should_retransmit(result)) {
+            break;
+        }
+        retries--;
+    }
+    
+    return result;
+}
+
+/**
+ * Ask the device for the state of n sessions with one POLL request.
+ * Sessions with no result are left FN_ERR_IO.
+ */
+static uint8_t _poll_batch(fn_poll_t *sessions, uint8_t n)
+{
+    uint16_t req_len;
+    uint16_t resp_len;
+    uint16_t pos;
+    uint16_t available;
+    fn_handle_t handle;
+    uint8_t results;
+    uint8_t flags;
+    uint8_t result;
+    uint8_t retries;
+    uint8_t i;
+    uint8_t j;
+    
+    req_len = fn_build_poll_packet(fn_req_buf, sessions, n);
     if (req_len == 0) {
         return FN_ERR_INVALID;
     }
     
-    result = fn_transport_exchange(_req_buf, req_len, _resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    /* POLL has no side effects, so a lost or corrupted response is retried */
+    retries = FN_TRANSPORT_RETRIES;
+    for (;;) {
+        result = _exchange_attempt(req_len, &resp_len, retries);
+        if (result == FN_OK) {
+            result = fn_parse_poll_response(fn_resp_buf, resp_len, &results, &pos);
+        }
+        if (retries == 0 || !_should_retransmit(result)) {
+            break;
+        }
+        retries--;
+    }
     if (result != FN_OK) {
         return result;
     }
     
-    result = fn_parse_info_response(_resp_buf, resp_len, &resp_handle, http_status, content_length, flags);
+    for (i = 0; i < n; i++) {
+        sessions[i].result = FN_ERR_IO;
+    }
     
-    return result;
+    /* Results normally come in request order; look further if not */
+    for (i = 0; i < results; i++) {
+        result = fn_parse_poll_entry(fn_resp_buf, resp_len, &pos, &handle, &flags, &available);
+        if (result != FN_OK) {
+            return result;
+        }
+        j = i;
+        if (j >= n || sessions[j].handle != handle) {
+            for (j = 0; j < n && sessions[j].handle != handle; j++) {
+            }
+        }
+        if (j < n) {
+            sessions[j].flags = flags;
+            sessions[j].result = FN_OK;
+            sessions[j].available = available;
+        }
+    }
+    
+    return FN_OK;
+}
+
+uint8_t fn_poll(fn_poll_t *sessions, uint16_t max, uint16_t *count)
+{
+    uint32_t content_length;
+#if FN_READ_AHEAD_BUFFERS > 0
+    uint32_t pos;
+#endif
+    uint16_t http_status;
+    uint16_t per;
+    uint16_t batch;
+    uint16_t n;
+    uint16_t i;
+    uint16_t j;
+    uint8_t result;
+    int16_t slot;
+    
+    if (!_initialized) {
+        return FN_ERR_INVALID;
+    }
+    
+    if (count == NULL || (sessions == NULL && max > 0)) {
+        return FN_ERR_INVALID;
+    }
+    
+    *count = 0;
+    
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
+    }
+    
+    /* Every open session gets an entry; say how many if they don't fit */
+    if (_session_count > max) {
+        *count = _session_count;
+        return FN_ERR_INVALID;
+    }
+    
+    /* List the open sessions, sending their buffered writes as a read would */
+    n = 0;
+    for (slot = 0; slot < FN_SESSION_TABLE_SIZE; slot++) {
+        if (!_sessions[slot].active) {
+            continue;
+        }
+        sessions[n].handle = _sessions[slot].handle;
+        sessions[n].flags = 0;
+        sessions[n].result = _flush(slot);
+        sessions[n].available = 0;
+        n++;
+    }
+    
+    /* As many sessions per request as the response frame has room for */
+    per = (fn_max_frame - FN_POLL_RESP_OVERHEAD) / FN_POLL_ENTRY_SIZE;
+    if (per > FN_POLL_MAX_COUNT) {
+        per = FN_POLL_MAX_COUNT;
+    }
+    
+    for (i = 0; i < n; i += batch) {
+        batch = n - i;
+        if (batch > per) {
+            batch = per;
+        }
+        if (_poll_ok) {
+            result = _poll_batch(sessions + i, (uint8_t)batch);
+            if (result == FN_ERR_UNSUPPORTED) {
+                _poll_ok = 0;
+            } else if (result != FN_OK) {
+                return result;
+            }
+        }
+        if (!_poll_ok) {
+            /* One INFO per session; one that fails reports no flags */
+            for (j = i; j < i + batch; j++) {
+                sessions[j].result = fn_info(sessions[j].handle, &http_status, &content_length,
+                                             &sessions[j].flags);
+                if (sessions[j].result != FN_OK) {
+                    sessions[j].flags = 0;
+                }
+            }
+        }
+    }
+    
+    for (i = 0; i < n; i++) {
+        slot = _find_session(sessions[i].handle);
+        
+        /* Buffered writes that didn't go out outrank what the device said */
+        if (_sessions[slot].wb_error != FN_OK) {
+            sessions[i].result = _sessions[slot].wb_error;
+        }
+        
+#if FN_READ_AHEAD_BUFFERS > 0
+        /* Data in a sequential session's read-ahead buffer is ready too */
+        if (_sessions[slot].ra_buf == NULL ||
+            !(_sessions[slot].proto_flags & FN_PROTO_FLAG_SEQUENTIAL_READ)) {
+            continue;
+        }
+        pos = _sessions[slot].read_offset - _sessions[slot].ra_offset;
+        if (pos < _sessions[slot].ra_len) {
+            pos = (uint32_t)sessions[i].available + (_sessions[slot].ra_len - pos);
+            sessions[i].available = pos > 0xFFFF ? 0xFFFF : (uint16_t)pos;
+        }
+#endif
+    }
+    
+    *count = n;
+    return FN_OK;
 }
 
 uint8_t fn_close(fn_handle_t handle)
 {
     uint16_t req_len;
     uint16_t resp_len;
+    uint8_t flushed;
     uint8_t result;
+    int16_t slot;
     
     if (!_initialized) {
         return FN_ERR_INVALID;
@@ -396,16 +2080,28 @@ uint8_t fn_close(fn_handle_t handle)
         return FN_ERR_INVALID;
     }
     
-    req_len = fn_build_close_packet(_req_buf, handle);
+    /* The link belongs to an async operation; close later */
+    if (fn_async_busy) {
+        return FN_ERR_BUSY;
+    }
+    
+    /* Send buffered writes; the session is closed even if that fails */
+    flushed = FN_OK;
+    slot = _find_session(handle);
+    if (slot >= 0) {
+        flushed = _flush(slot);
+    }
+    
+    req_len = fn_build_close_packet(fn_req_buf, handle);
     if (req_len == 0) {
         return FN_ERR_INVALID;
     }
     
-    result = fn_transport_exchange(_req_buf, req_len, _resp_buf, FN_MAX_PACKET_SIZE, &resp_len);
+    result = fn_exchange(fn_req_buf, req_len, fn_resp_buf, fn_max_frame, &resp_len);
     
     _free_handle(handle);
     
-    return result;
+    return result != FN_OK ? result : flushed;
 }
 
 /* ============================================================================
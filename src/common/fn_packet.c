@@ -8,17 +8,14 @@
  */
 
 #include "fn_protocol.h"
+#include "fn_platform.h"
 #include "fn_internal.h"
 #include <string.h>
 
 /* ============================================================================
- * Static Buffers (for cc65 compatibility - no large stack buffers)
+ * Static Tables
  * ============================================================================ */
 
-/* Temporary buffer for checksum calculation */
-#define FN_TMP_BUFFER_SIZE 1024
-static uint8_t fn_tmp_buffer[FN_TMP_BUFFER_SIZE];
-
 /* Field size table for descriptor parsing */
 static const uint8_t fn_field_size_table[8] = {0, 1, 1, 1, 1, 2, 2, 4};
 
@@ -29,27 +26,45 @@ static const uint8_t fn_field_count_table[8] = {0, 1, 2, 3, 4, 1, 2, 1};
  * Checksum Calculation
  * ============================================================================ */
 
+#ifndef FN_HAVE_FAST_CHECKSUM
 /**
- * Calculate FujiBus checksum.
+ * Add bytes to a running FujiBus checksum.
  * 
- * The checksum is a sum of all bytes with carry folding.
+ * The checksum is a sum of all bytes with carry folding. A zero byte
+ * leaves it unchanged, so a packet can be checked in place by summing
+ * the spans either side of its checksum byte. Platforms that define
+ * FN_HAVE_FAST_CHECKSUM provide a wider version of this loop.
  * 
- * @param data    Packet data
+ * @param chk     Checksum so far (0 to start)
+ * @param data    Data to add
  * @param len     Length of data
- * @return Checksum byte
+ * @return Updated checksum
  */
-uint8_t fn_calc_checksum(const uint8_t *data, uint16_t len)
+uint8_t fn_checksum_update(uint8_t chk, const uint8_t *data, uint16_t len)
 {
-    uint16_t chk;
+    uint16_t sum;
     uint16_t i;
     
-    chk = 0;
+    sum = chk;
     for (i = 0; i < len; i++) {
-        chk += data[i];
-        chk = ((chk >> 8) + (chk & 0xFF)) & 0xFFFF;
+        sum += data[i];
+        sum = (sum >> 8) + (sum & 0xFF);
     }
     
-    return (uint8_t)(chk & 0xFF);
+    return (uint8_t)sum;
+}
+#endif
+
+/**
+ * Calculate FujiBus checksum.
+ * 
+ * @param data    Packet data
+ * @param len     Length of data
+ * @return Checksum byte
+ */
+uint8_t fn_calc_checksum(const uint8_t *data, uint16_t len)
+{
+    return fn_checksum_update(0, data, len);
 }
 
 /* ============================================================================
@@ -260,25 +275,124 @@ uint16_t fn_build_read_packet(uint8_t *buffer,
 }
 
 /**
- * Build a Write request packet.
+ * Build a Read Multi request packet: one READ for each of several sessions.
+ * 
+ * @param buffer     Output buffer
+ * @param reads      Handle, offset and maximum for each session
+ * @param count      Number of sessions (1..FN_MAX_READ_MULTI)
+ * @return Packet length
+ */
+uint16_t fn_build_read_multi_packet(uint8_t *buffer,
+                                    const fn_read_req_t *reads,
+                                    uint8_t count)
+{
+    uint16_t offset;
+    uint16_t total_len;
+    uint8_t checksum;
+    uint8_t i;
+    
+    if (count == 0 || count > FN_MAX_READ_MULTI) {
+        return 0;
+    }
+    
+    /* Payload: version(1) + count(1) + count * (handle(2) + offset(4) + max_bytes(2)) */
+    total_len = FN_HEADER_SIZE + 2 + count * 8;
+    
+    /* Build header */
+    offset = fn_build_header(buffer, FN_DEVICE_NETWORK, FN_CMD_READ_MULTI, total_len);
+    
+    buffer[offset++] = FN_PROTOCOL_VERSION;
+    buffer[offset++] = count;
+    
+    for (i = 0; i < count; i++) {
+        buffer[offset++] = reads[i].handle & 0xFF;
+        buffer[offset++] = (reads[i].handle >> 8) & 0xFF;
+        buffer[offset++] = reads[i].offset & 0xFF;
+        buffer[offset++] = (reads[i].offset >> 8) & 0xFF;
+        buffer[offset++] = (reads[i].offset >> 16) & 0xFF;
+        buffer[offset++] = (reads[i].offset >> 24) & 0xFF;
+        buffer[offset++] = reads[i].max_bytes & 0xFF;
+        buffer[offset++] = (reads[i].max_bytes >> 8) & 0xFF;
+    }
+    
+    /* Calculate and insert checksum */
+    checksum = fn_calc_checksum(buffer, offset);
+    buffer[4] = checksum;
+    
+    return offset;
+}
+
+/**
+ * Build a Poll request packet: the handles of the sessions to report on.
  * 
  * @param buffer     Output buffer
+ * @param sessions   Sessions to report on (only the handles are sent)
+ * @param count      Number of sessions (1..FN_POLL_MAX_COUNT)
+ * @return Packet length
+ */
+uint16_t fn_build_poll_packet(uint8_t *buffer,
+                              const fn_poll_t *sessions,
+                              uint8_t count)
+{
+    uint16_t offset;
+    uint16_t total_len;
+    uint8_t checksum;
+    uint8_t i;
+    
+    if (count == 0) {
+        return 0;
+    }
+    
+    /* Payload: version(1) + count(1) + count * handle(2) */
+    total_len = FN_HEADER_SIZE + 2 + count * 2;
+    
+    /* Build header */
+    offset = fn_build_header(buffer, FN_DEVICE_NETWORK, FN_CMD_POLL, total_len);
+    
+    buffer[offset++] = FN_PROTOCOL_VERSION;
+    buffer[offset++] = count;
+    
+    for (i = 0; i < count; i++) {
+        buffer[offset++] = sessions[i].handle & 0xFF;
+        buffer[offset++] = (sessions[i].handle >> 8) & 0xFF;
+    }
+    
+    /* Calculate and insert checksum */
+    checksum = fn_calc_checksum(buffer, offset);
+    buffer[4] = checksum;
+    
+    return offset;
+}
+
+/**
+ * Build the head of a Write request packet: header and fields, without
+ * the data. The checksum covers the data too, so head and data can be
+ * sent as they are, one after the other, without copying the data.
+ * 
+ * @param buffer     Output buffer (at least FN_WRITE_REQ_OVERHEAD bytes)
  * @param handle     Session handle
  * @param offset     Write offset
- * @param data       Data to write
- * @param data_len   Length of data
- * @return Packet length
+ * @param data       Segments holding the data, in order
+ * @param count      Number of segments
+ * @return Head length (FN_WRITE_REQ_OVERHEAD)
  */
-uint16_t fn_build_write_packet(uint8_t *buffer,
-                                fn_handle_t handle,
-                                uint32_t offset_val,
-                                const uint8_t *data,
-                                uint16_t data_len)
+uint16_t fn_build_write_head(uint8_t *buffer,
+                             fn_handle_t handle,
+                             uint32_t offset_val,
+                             const fn_segment_t *data,
+                             uint8_t count)
 {
     uint16_t offset;
+    uint16_t data_len;
     uint16_t payload_len;
     uint16_t total_len;
     uint8_t checksum;
+    uint8_t i;
+    
+    data_len = 0;
+    for (i = 0; i < count; i++) {
+        data_len += data[i].len;
+    }
     
     /* Payload: version(1) + handle(2) + offset(4) + data_len(2) + data */
     payload_len = 1 + 2 + 4 + 2 + data_len;
@@ -304,19 +418,50 @@ uint16_t fn_build_write_packet(uint8_t *buffer,
     buffer[offset++] = data_len & 0xFF;
     buffer[offset++] = (data_len >> 8) & 0xFF;
     
-    /* Data */
-    if (data_len > 0 && data != NULL) {
-        memcpy(buffer + offset, data, data_len);
-        offset += data_len;
-    }
-    
-    /* Calculate and insert checksum */
+    /* Calculate and insert checksum (of head and data) */
     checksum = fn_calc_checksum(buffer, offset);
+    for (i = 0; i < count; i++) {
+        if (data[i].len > 0) {
+            checksum = fn_checksum_update(checksum, data[i].data, data[i].len);
+        }
+    }
     buffer[4] = checksum;  /* Checksum is at offset 4 */
     
     return offset;
 }
 
+/**
+ * Build a Write request packet.
+ * 
+ * @param buffer     Output buffer
+ * @param handle     Session handle
+ * @param offset     Write offset
+ * @param data       Data to write
+ * @param data_len   Length of data
+ * @return Packet length
+ */
+uint16_t fn_build_write_packet(uint8_t *buffer,
+                                fn_handle_t handle,
+                                uint32_t offset_val,
+                                const uint8_t *data,
+                                uint16_t data_len)
+{
+    fn_segment_t seg;
+    uint16_t offset;
+    
+    seg.data = data;
+    seg.len = (data != NULL) ? data_len : 0;
+    offset = fn_build_write_head(buffer, handle, offset_val, &seg, 1);
+    
+    /* Data */
+    if (seg.len > 0) {
+        memcpy(buffer + offset, data, seg.len);
+        offset += seg.len;
+    }
+    
+    return offset;
+}
+
 /**
  * Build a Close request packet.
  * 
@@ -387,6 +532,258 @@ uint16_t fn_build_info_packet(uint8_t *buffer, fn_handle_t handle)
     return offset;
 }
 
+#if FN_MAX_FRAME_SIZE > FN_MAX_PACKET_SIZE
+/**
+ * Build a Frame Size request packet (Fuji device).
+ * 
+ * @param buffer     Output buffer
+ * @param max_frame  Largest frame the host can handle
+ * @return Packet length
+ */
+uint16_t fn_build_frame_size_packet(uint8_t *buffer, uint16_t max_frame)
+{
+    uint16_t offset;
+    uint16_t payload_len;
+    uint16_t total_len;
+    uint8_t checksum;
+    
+    /* Payload: version(1) + max_frame(2) = 3 bytes */
+    payload_len = 3;
+    total_len = FN_HEADER_SIZE + payload_len;
+    
+    /* Build header */
+    offset = fn_build_header(buffer, FN_DEVICE_FUJI, FN_CMD_FUJI_FRAME_SIZE, total_len);
+    
+    /* Version */
+    buffer[offset++] = FN_PROTOCOL_VERSION;
+    
+    /* Max frame (little-endian) */
+    buffer[offset++] = max_frame & 0xFF;
+    buffer[offset++] = (max_frame >> 8) & 0xFF;
+    
+    /* Calculate and insert checksum */
+    checksum = fn_calc_checksum(buffer, offset);
+    buffer[4] = checksum;  /* Checksum is at offset 4 */
+    
+    return offset;
+}
+#endif
+
+/* ============================================================================
+ * Wire Packet Writer
+ * ============================================================================ */
+
+#ifdef FN_TRANSPORT_EXCHANGE_WIRE
+
+#ifdef FN_HAVE_FAST_CHECKSUM
+/* Smallest piece worth a separate checksum and escape pass */
+#define WIRE_PIECE_MIN  32
+#endif
+
+/**
+ * Start a packet in a wire buffer.
+ * 
+ * The payload goes in after FN_WIRE_HEADROOM bytes; fn_wire_end() fills
+ * in the frame start and header in front of it.
+ * 
+ * @param w       Writer state
+ * @param buf     Wire buffer
+ * @param size    Wire buffer size (more than FN_WIRE_HEADROOM)
+ */
+void fn_wire_begin(fn_wire_t *w, uint8_t *buf, uint16_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->pos = FN_WIRE_HEADROOM;
+    w->raw = 0;
+    w->chk = 0;
+}
+
+/**
+ * Append payload bytes to a packet, escaping them and adding them to
+ * the checksum in one pass.
+ * 
+ * If the escaped bytes don't fit, the writer is marked as overflowed
+ * and fn_wire_end() will fail.
+ * 
+ * @param w       Writer state
+ * @param data    Payload bytes
+ * @param len     Number of bytes
+ */
+void fn_wire_put(fn_wire_t *w, const uint8_t *data, uint16_t len)
+{
+    uint16_t sum;
+    uint16_t pos;
+    uint16_t i;
+    uint8_t b;
+#ifdef FN_HAVE_FAST_CHECKSUM
+    uint16_t n;
+#endif
+    
+    if (w->pos == 0) {
+        return;
+    }
+    
+#ifdef FN_HAVE_FAST_CHECKSUM
+    /*
+     * Two passes with the wide checksum and escape loops beat one byte
+     * loop. Escaping may double the data, so take pieces that fit even
+     * then (they shrink as the buffer fills) and finish byte by byte.
+     */
+    i = 0;
+    for (;;) {
+        n = (w->size - w->pos) / 2;
+        if (n > len - i) {
+            n = len - i;
+        }
+        if (n < WIRE_PIECE_MIN) {
+            break;
+        }
+        w->chk = fn_checksum_update(w->chk, data + i, n);
+        w->pos += fn_slip_escape(data + i, n, w->buf + w->pos);
+        w->raw += n;
+        i += n;
+    }
+    if (i == len) {
+        return;
+    }
+    data += i;
+    len -= i;
+#endif
+    
+    sum = w->chk;
+    pos = w->pos;
+    for (i = 0; i < len; i++) {
+        b = data[i];
+        sum += b;
+        sum = (sum >> 8) + (sum & 0xFF);
+        
+        if (b == SLIP_END || b == SLIP_ESCAPE) {
+            if (w->size - pos < 2) {
+                w->pos = 0;
+                return;
+            }
+            w->buf[pos++] = SLIP_ESCAPE;
+            w->buf[pos++] = (b == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+        } else {
+            if (pos == w->size) {
+                w->pos = 0;
+                return;
+            }
+            w->buf[pos++] = b;
+        }
+    }
+    
+    w->chk = (uint8_t)sum;
+    w->pos = pos;
+    w->raw += len;
+}
+
+/**
+ * Finish a packet.
+ * 
+ * Now that the payload length and checksum are known, the header is
+ * escaped into the headroom, ending where the payload starts, and the
+ * opening END goes just before it.
+ * 
+ * @param w           Writer state
+ * @param device_id   WireDeviceId
+ * @param command     Command byte
+ * @param start       Pointer to receive the frame's offset in the wire buffer
+ * @return Frame length, or 0 if the packet did not fit
+ */
+uint16_t fn_wire_end(fn_wire_t *w, uint8_t device_id, uint8_t command, uint16_t *start)
+{
+    uint8_t header[FN_HEADER_SIZE];
+    uint16_t hdr_len;
+    uint8_t i;
+    
+    /* The closing END needs one more byte */
+    if (w->pos == 0 || w->pos == w->size) {
+        return 0;
+    }
+    
+    fn_build_header(header, device_id, command, FN_HEADER_SIZE + w->raw);
+    header[4] = fn_checksum_update(w->chk, header, FN_HEADER_SIZE);
+    
+    hdr_len = FN_HEADER_SIZE;
+    for (i = 0; i < FN_HEADER_SIZE; i++) {
+        if (header[i] == SLIP_END || header[i] == SLIP_ESCAPE) {
+            hdr_len++;
+        }
+    }
+    
+    *start = FN_WIRE_HEADROOM - hdr_len - 1;
+    w->buf[*start] = SLIP_END;
+    fn_slip_escape(header, FN_HEADER_SIZE, w->buf + *start + 1);
+    w->buf[w->pos++] = SLIP_END;
+    
+    return w->pos - *start;
+}
+
+/**
+ * Build a Write request packet as a SLIP frame, ready to send.
+ * 
+ * Same packet as fn_build_write_packet(), but the data is read once,
+ * on its way into the wire buffer, instead of being copied, summed and
+ * then encoded by the transport.
+ * 
+ * @param wire       Wire buffer
+ * @param wire_size  Wire buffer size
+ * @param start      Pointer to receive the frame's offset in the wire buffer
+ * @param handle     Session handle
+ * @param offset     Write offset
+ * @param data       Segments holding the data, in order
+ * @param count      Number of segments
+ * @return Frame length, or 0 if it does not fit the wire buffer
+ */
+uint16_t fn_build_write_wire(uint8_t *wire,
+                             uint16_t wire_size,
+                             uint16_t *start,
+                             fn_handle_t handle,
+                             uint32_t offset_val,
+                             const fn_segment_t *data,
+                             uint8_t count)
+{
+    fn_wire_t w;
+    uint8_t fields[9];
+    uint16_t data_len;
+    uint8_t i;
+    
+    data_len = 0;
+    for (i = 0; i < count; i++) {
+        data_len += data[i].len;
+    }
+    
+    /* Version */
+    fields[0] = FN_PROTOCOL_VERSION;
+    
+    /* Handle (little-endian) */
+    fields[1] = handle & 0xFF;
+    fields[2] = (handle >> 8) & 0xFF;
+    
+    /* Offset (little-endian) */
+    fields[3] = offset_val & 0xFF;
+    fields[4] = (offset_val >> 8) & 0xFF;
+    fields[5] = (offset_val >> 16) & 0xFF;
+    fields[6] = (offset_val >> 24) & 0xFF;
+    
+    /* Data length (little-endian) */
+    fields[7] = data_len & 0xFF;
+    fields[8] = (data_len >> 8) & 0xFF;
+    
+    fn_wire_begin(&w, wire, wire_size);
+    fn_wire_put(&w, fields, sizeof(fields));
+    for (i = 0; i < count; i++) {
+        if (data[i].len > 0) {
+            fn_wire_put(&w, data[i].data, data[i].len);
+        }
+    }
+    
+    return fn_wire_end(&w, FN_DEVICE_NETWORK, FN_CMD_WRITE, start);
+}
+#endif
+
 /* ============================================================================
  * Response Parsing Functions
  * ============================================================================ */
@@ -420,6 +817,7 @@ uint8_t fn_parse_response_header(const uint8_t *response,
     
     /* Minimum response: header(6) */
     if (resp_len < FN_HEADER_SIZE) {
+        fn_frame_damaged = 1;
         return FN_ERR_INVALID;
     }
     
@@ -428,18 +826,18 @@ uint8_t fn_parse_response_header(const uint8_t *response,
     
     /* Verify packet length matches */
     if (pkt_len != resp_len) {
+        fn_frame_damaged = 1;
         return FN_ERR_INVALID;
     }
     
-    /* Verify checksum - copy to temp buffer and zero checksum byte */
-    if (resp_len > FN_TMP_BUFFER_SIZE) {
-        return FN_ERR_INVALID;
-    }
-    memcpy(fn_tmp_buffer, response, resp_len);
-    fn_tmp_buffer[4] = 0;  /* Zero checksum for calculation */
-    checksum = fn_calc_checksum(fn_tmp_buffer, resp_len);
-    if (checksum != response[4]) {
-        return FN_ERR_IO;
+    /* Verify checksum (unless the link is reliable), skipping the checksum byte itself */
+    if (FN_TRANSPORT_CAPS() & FN_TRANSPORT_CAP_CHECKSUM) {
+        checksum = fn_checksum_update(0, response, 4);
+        checksum = fn_checksum_update(checksum, response + 5, resp_len - 5);
+        if (checksum != response[4]) {
+            fn_frame_damaged = 1;
+            return FN_ERR_IO;
+        }
     }
     
     /* Extract descriptor */
@@ -539,33 +937,30 @@ uint8_t fn_parse_open_response(const uint8_t *response,
 }
 
 /**
- * Parse a Read response.
+ * Parse a Read response, leaving the data where it is.
  * 
  * @param response     Response packet
  * @param resp_len     Response length
  * @param handle       Pointer to receive handle
  * @param offset_echo  Pointer to receive offset echo
  * @param flags        Pointer to receive flags
- * @param data         Buffer to receive data
- * @param data_max     Maximum data buffer size
- * @param data_len     Pointer to receive actual data length
+ * @param data         Pointer to receive the address of the data in response
+ * @param data_len     Pointer to receive data length
  * @return FN_OK on success, error code on failure
  */
-uint8_t fn_parse_read_response(const uint8_t *response,
-                                uint16_t resp_len,
-                                fn_handle_t *handle,
-                                uint32_t *offset_echo,
-                                uint8_t *flags,
-                                uint8_t *data,
-                                uint16_t data_max,
-                                uint16_t *data_len)
+uint8_t fn_parse_read_view(const uint8_t *response,
+                            uint16_t resp_len,
+                            fn_handle_t *handle,
+                            uint32_t *offset_echo,
+                            uint8_t *flags,
+                            const uint8_t **data,
+                            uint16_t *data_len)
 {
     uint8_t status;
     uint16_t data_offset;
     uint16_t payload_len;
     uint8_t result;
     uint16_t actual_data_len;
-    uint16_t copy_len;
     
     result = fn_parse_response_header(response, resp_len, &status, &data_offset, &payload_len);
     if (result != FN_OK) {
@@ -590,17 +985,228 @@ uint8_t fn_parse_read_response(const uint8_t *response,
     
     actual_data_len = response[data_offset + 10] | (response[data_offset + 11] << 8);
     
+    /* The data must be in the packet */
+    if (actual_data_len > payload_len - 12) {
+        return FN_ERR_INVALID;
+    }
+    
+    *data = response + data_offset + 12;
+    *data_len = actual_data_len;
+    
+    return FN_OK;
+}
+
+/**
+ * Parse a Read response.
+ * 
+ * @param response     Response packet
+ * @param resp_len     Response length
+ * @param handle       Pointer to receive handle
+ * @param offset_echo  Pointer to receive offset echo
+ * @param flags        Pointer to receive flags
+ * @param data         Buffer to receive data
+ * @param data_max     Maximum data buffer size
+ * @param data_len     Pointer to receive actual data length
+ * @return FN_OK on success, error code on failure
+ */
+uint8_t fn_parse_read_response(const uint8_t *response,
+                                uint16_t resp_len,
+                                fn_handle_t *handle,
+                                uint32_t *offset_echo,
+                                uint8_t *flags,
+                                uint8_t *data,
+                                uint16_t data_max,
+                                uint16_t *data_len)
+{
+    const uint8_t *view;
+    uint8_t result;
+    uint16_t copy_len;
+    
+    result = fn_parse_read_view(response, resp_len, handle, offset_echo, flags, &view, data_len);
+    if (result != FN_OK) {
+        return result;
+    }
+    
     /* Copy data */
-    copy_len = actual_data_len;
+    copy_len = *data_len;
     if (copy_len > data_max) {
         copy_len = data_max;
     }
     
     if (copy_len > 0 && data != NULL) {
-        memcpy(data, response + data_offset + 12, copy_len);
+        memcpy(data, view, copy_len);
     }
     
-    *data_len = actual_data_len;
+    return FN_OK;
+}
+
+/**
+ * Parse the head of a Read Multi response.
+ * 
+ * @param response     Response packet
+ * @param resp_len     Response length
+ * @param count        Pointer to receive the number of results
+ * @param pos          Pointer to receive the offset of the first result
+ * @return FN_OK on success, error code on failure (FN_ERR_UNSUPPORTED
+ *         from devices without Read Multi)
+ */
+uint8_t fn_parse_read_multi_response(const uint8_t *response,
+                                     uint16_t resp_len,
+                                     uint8_t *count,
+                                     uint16_t *pos)
+{
+    uint8_t status;
+    uint16_t data_offset;
+    uint16_t payload_len;
+    uint8_t result;
+    
+    result = fn_parse_response_header(response, resp_len, &status, &data_offset, &payload_len);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    if (status != FN_OK) {
+        return status;
+    }
+    
+    /* Read Multi response payload: version(1) + flags(1) + reserved(2) + count(1) + results */
+    if (payload_len < 5) {
+        return FN_ERR_INVALID;
+    }
+    
+    *count = response[data_offset + 4];
+    *pos = data_offset + 5;
+    
+    return FN_OK;
+}
+
+/**
+ * Parse one Read Multi result, leaving the data where it is.
+ * 
+ * Result format: handle(2) + status(1) + flags(1) + offset(4) + data_len(2) + data
+ * 
+ * @param response     Response packet
+ * @param resp_len     Response length
+ * @param pos          Offset of the result; moved to the next one
+ * @param handle       Pointer to receive handle
+ * @param status       Pointer to receive the session's status
+ * @param flags        Pointer to receive flags
+ * @param offset_echo  Pointer to receive the offset the data was read from
+ * @param data         Pointer to receive the address of the data in response
+ * @param data_len     Pointer to receive data length
+ * @return FN_OK on success, FN_ERR_INVALID if the result is cut short
+ */
+uint8_t fn_parse_read_multi_entry(const uint8_t *response,
+                                  uint16_t resp_len,
+                                  uint16_t *pos,
+                                  fn_handle_t *handle,
+                                  uint8_t *status,
+                                  uint8_t *flags,
+                                  uint32_t *offset_echo,
+                                  const uint8_t **data,
+                                  uint16_t *data_len)
+{
+    uint16_t p;
+    uint16_t len;
+    
+    p = *pos;
+    if (p > resp_len || resp_len - p < FN_READ_MULTI_ENTRY_SIZE) {
+        return FN_ERR_INVALID;
+    }
+    
+    *handle = response[p] | (response[p + 1] << 8);
+    *status = response[p + 2];
+    *flags = response[p + 3];
+    *offset_echo = ((uint32_t)response[p + 4]) |
+                   ((uint32_t)response[p + 5] << 8) |
+                   ((uint32_t)response[p + 6] << 16) |
+                   ((uint32_t)response[p + 7] << 24);
+    len = response[p + 8] | (response[p + 9] << 8);
+    p += FN_READ_MULTI_ENTRY_SIZE;
+    
+    /* The data must be in the packet */
+    if (len > resp_len - p) {
+        return FN_ERR_INVALID;
+    }
+    
+    *data = response + p;
+    *data_len = len;
+    *pos = p + len;
+    
+    return FN_OK;
+}
+
+/**
+ * Parse the head of a Poll response.
+ * 
+ * @param response     Response packet
+ * @param resp_len     Response length
+ * @param count        Pointer to receive the number of results
+ * @param pos          Pointer to receive the offset of the first result
+ * @return FN_OK on success, error code on failure (FN_ERR_UNSUPPORTED
+ *         from devices without Poll)
+ */
+uint8_t fn_parse_poll_response(const uint8_t *response,
+                               uint16_t resp_len,
+                               uint8_t *count,
+                               uint16_t *pos)
+{
+    uint8_t status;
+    uint16_t data_offset;
+    uint16_t payload_len;
+    uint8_t result;
+    
+    result = fn_parse_response_header(response, resp_len, &status, &data_offset, &payload_len);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    if (status != FN_OK) {
+        return status;
+    }
+    
+    /* Poll response payload: version(1) + flags(1) + reserved(2) + count(1) + results */
+    if (payload_len < 5) {
+        return FN_ERR_INVALID;
+    }
+    
+    *count = response[data_offset + 4];
+    *pos = data_offset + 5;
+    
+    return FN_OK;
+}
+
+/**
+ * Parse one Poll result.
+ * 
+ * Result format: handle(2) + flags(1) + available(2)
+ * 
+ * @param response     Response packet
+ * @param resp_len     Response length
+ * @param pos          Offset of the result; moved to the next one
+ * @param handle       Pointer to receive handle
+ * @param flags        Pointer to receive info flags (FN_INFO_*)
+ * @param available    Pointer to receive bytes ready to read
+ * @return FN_OK on success, FN_ERR_INVALID if the result is cut short
+ */
+uint8_t fn_parse_poll_entry(const uint8_t *response,
+                            uint16_t resp_len,
+                            uint16_t *pos,
+                            fn_handle_t *handle,
+                            uint8_t *flags,
+                            uint16_t *available)
+{
+    uint16_t p;
+    
+    p = *pos;
+    if (p > resp_len || resp_len - p < FN_POLL_ENTRY_SIZE) {
+        return FN_ERR_INVALID;
+    }
+    
+    *handle = response[p] | (response[p + 1] << 8);
+    *flags = response[p + 2];
+    *available = response[p + 3] | (response[p + 4] << 8);
+    *pos = p + FN_POLL_ENTRY_SIZE;
     
     return FN_OK;
 }
@@ -661,3 +1267,41 @@ uint8_t fn_parse_info_response(const uint8_t *response,
     
     return FN_OK;
 }
+
+#if FN_MAX_FRAME_SIZE > FN_MAX_PACKET_SIZE
+/**
+ * Parse a Frame Size response.
+ * 
+ * @param response   Response packet
+ * @param resp_len   Response length
+ * @param max_frame  Pointer to receive the largest frame the device accepts
+ * @return FN_OK on success, error code on failure
+ */
+uint8_t fn_parse_frame_size_response(const uint8_t *response,
+                                     uint16_t resp_len,
+                                     uint16_t *max_frame)
+{
+    uint8_t status;
+    uint16_t data_offset;
+    uint16_t data_len;
+    uint8_t result;
+    
+    result = fn_parse_response_header(response, resp_len, &status, &data_offset, &data_len);
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    if (status != FN_OK) {
+        return status;
+    }
+    
+    /* Frame size response payload: version(1) + flags(1) + reserved(2) + max_frame(2) */
+    if (data_len < 6) {
+        return FN_ERR_INVALID;
+    }
+    
+    *max_frame = response[data_offset + 4] | (response[data_offset + 5] << 8);
+    
+    return FN_OK;
+}
+#endif
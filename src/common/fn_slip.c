@@ -5,37 +5,69 @@
  * Implements SLIP (Serial Line IP) framing for FujiBus packets.
  * SLIP provides simple packet delimiting over byte-stream transports.
  * 
+ * The byte-at-a-time loops are the reference implementation. Platforms
+ * that define FN_HAVE_SLIP_SCAN provide fn_slip_scan(), and once a few
+ * ordinary bytes go by in a row the codec finds the end of the run with
+ * it and copies the run in bulk. Dense data stays on the byte loop, where
+ * a scan per special byte would cost more than it saves.
+ * 
  * @version 1.0.0
  */
 
 #include "fn_protocol.h"
+#include "fn_internal.h"
+#ifdef FN_HAVE_SLIP_SCAN
+#include <string.h>
+
+/** Ordinary bytes in a row before the rest of the run is scanned */
+#define SLIP_SCAN_AFTER  8
+#endif
 
 /**
- * Encode data with SLIP framing.
- * 
- * Adds SLIP END markers at start and end, and escapes any END or ESCAPE
- * bytes in the data.
+ * Escape data for a SLIP frame, without the END markers.
  * 
  * @param input    Input data buffer
  * @param in_len   Length of input data
- * @param output   Output buffer for SLIP-encoded data
- * @return Length of encoded data
+ * @param output   Output buffer (up to twice in_len)
+ * @return Length of escaped data
  */
-uint16_t fn_slip_encode(const uint8_t *input, uint16_t in_len, uint8_t *output)
+uint16_t fn_slip_escape(const uint8_t *input, uint16_t in_len, uint8_t *output)
 {
     uint16_t out_len;
     uint16_t i;
     uint8_t b;
+#ifdef FN_HAVE_SLIP_SCAN
+    uint16_t run;
+    uint8_t plain;
     
-    out_len = 0;
+    plain = 0;
+#endif
     
-    /* Start with END marker */
-    output[out_len++] = SLIP_END;
+    out_len = 0;
     
     /* Process each input byte */
     for (i = 0; i < in_len; i++) {
         b = input[i];
         
+#ifdef FN_HAVE_SLIP_SCAN
+        if (b != SLIP_END && b != SLIP_ESCAPE) {
+            if (++plain >= SLIP_SCAN_AFTER) {
+                /* Copy the rest of the run in one go */
+                run = fn_slip_scan(input + i, in_len - i);
+                memcpy(output + out_len, input + i, run);
+                out_len += run;
+                i += run;
+                plain = 0;
+                if (i == in_len) {
+                    break;
+                }
+                b = input[i];
+            }
+        } else {
+            plain = 0;
+        }
+#endif
+        
         if (b == SLIP_END) {
             /* Escape END byte */
             output[out_len++] = SLIP_ESCAPE;
@@ -50,6 +82,29 @@ uint16_t fn_slip_encode(const uint8_t *input, uint16_t in_len, uint8_t *output)
         }
     }
     
+    return out_len;
+}
+
+/**
+ * Encode data with SLIP framing.
+ * 
+ * Adds SLIP END markers at start and end, and escapes any END or ESCAPE
+ * bytes in the data.
+ * 
+ * @param input    Input data buffer
+ * @param in_len   Length of input data
+ * @param output   Output buffer for SLIP-encoded data
+ * @return Length of encoded data
+ */
+uint16_t fn_slip_encode(const uint8_t *input, uint16_t in_len, uint8_t *output)
+{
+    uint16_t out_len;
+    
+    /* Start with END marker */
+    output[0] = SLIP_END;
+    
+    out_len = 1 + fn_slip_escape(input, in_len, output + 1);
+    
     /* End with END marker */
     output[out_len++] = SLIP_END;
     
@@ -71,6 +126,12 @@ uint16_t fn_slip_decode(const uint8_t *input, uint16_t in_len, uint8_t *output)
     uint16_t out_len;
     uint16_t i;
     uint8_t b;
+#ifdef FN_HAVE_SLIP_SCAN
+    uint16_t run;
+    uint8_t plain;
+    
+    plain = 0;
+#endif
     
     out_len = 0;
     i = 0;
@@ -82,6 +143,24 @@ uint16_t fn_slip_decode(const uint8_t *input, uint16_t in_len, uint8_t *output)
     
     /* Process until next END or end of data */
     while (i < in_len) {
+#ifdef FN_HAVE_SLIP_SCAN
+        b = input[i];
+        if (b != SLIP_END && b != SLIP_ESCAPE) {
+            if (++plain >= SLIP_SCAN_AFTER) {
+                /* Copy the rest of the run in one go (may be in place) */
+                run = fn_slip_scan(input + i, in_len - i);
+                memmove(output + out_len, input + i, run);
+                out_len += run;
+                i += run;
+                plain = 0;
+                if (i == in_len) {
+                    break;
+                }
+            }
+        } else {
+            plain = 0;
+        }
+#endif
         b = input[i++];
         
         if (b == SLIP_END) {
@@ -115,6 +194,145 @@ uint16_t fn_slip_decode(const uint8_t *input, uint16_t in_len, uint8_t *output)
     return out_len;
 }
 
+/**
+ * Initialize a streaming SLIP decoder.
+ * 
+ * @param dec      Decoder state
+ * @param out      Buffer to receive the decoded frame
+ * @param out_max  Size of the output buffer
+ */
+void fn_slip_decoder_init(fn_slip_decoder_t *dec, uint8_t *out, uint16_t out_max)
+{
+    dec->out = out;
+    dec->out_max = out_max;
+    dec->len = 0;
+    dec->expect = 0;
+    dec->state = FN_SLIP_STATE_HUNT;
+}
+
+/**
+ * Feed a chunk of raw bytes to a streaming SLIP decoder.
+ * 
+ * Bytes may arrive in arbitrary pieces; escape state is carried across
+ * calls. Anything before the first END is discarded, as are empty frames.
+ * Decoding stops after the closing END of a frame so any following bytes
+ * can be fed again later. If dec->expect is set, the frame is also
+ * complete as soon as that many bytes have been decoded, without waiting
+ * for the closing END.
+ * 
+ * The input may lie inside the output buffer at or after out + len, in
+ * which case the frame is decoded in place (output never overtakes input).
+ * 
+ * @param dec       Decoder state
+ * @param input     Raw bytes
+ * @param in_len    Number of raw bytes
+ * @param consumed  Pointer to receive the number of bytes used
+ * @return FN_SLIP_MORE, FN_SLIP_FRAME or FN_SLIP_OVERFLOW
+ */
+uint8_t fn_slip_decoder_feed(fn_slip_decoder_t *dec,
+                             const uint8_t *input,
+                             uint16_t in_len,
+                             uint16_t *consumed)
+{
+    uint16_t i;
+    uint8_t b;
+#ifdef FN_HAVE_SLIP_SCAN
+    uint16_t run;
+    uint16_t room;
+    uint8_t plain;
+    
+    plain = 0;
+#endif
+    
+    for (i = 0; i < in_len; i++) {
+        b = input[i];
+        
+#ifdef FN_HAVE_SLIP_SCAN
+        if (dec->state == FN_SLIP_STATE_DATA && b != SLIP_END && b != SLIP_ESCAPE) {
+            if (++plain >= SLIP_SCAN_AFTER) {
+                /*
+                 * Copy the rest of the run in one go, stopping where the
+                 * frame is known to end or the buffer is full (the byte
+                 * loop then reports the overflow).
+                 */
+                room = (dec->expect != 0 ? dec->expect : dec->out_max) - dec->len;
+                run = fn_slip_scan(input + i, in_len - i);
+                if (run > room) {
+                    run = room;
+                }
+                memmove(dec->out + dec->len, input + i, run);
+                dec->len += run;
+                i += run;
+                plain = 0;
+                if (run != 0 && dec->len == dec->expect) {
+                    /* Length-delimited frame is complete */
+                    dec->state = FN_SLIP_STATE_HUNT;
+                    *consumed = i;
+                    return FN_SLIP_FRAME;
+                }
+                if (i == in_len) {
+                    break;
+                }
+                b = input[i];
+            }
+        } else {
+            plain = 0;
+        }
+#endif
+        
+        if (dec->state == FN_SLIP_STATE_HUNT) {
+            /* Skip line noise until a frame boundary */
+            if (b == SLIP_END) {
+                dec->state = FN_SLIP_STATE_DATA;
+                dec->len = 0;
+            }
+            continue;
+        }
+        
+        if (b == SLIP_END) {
+            if (dec->len == 0) {
+                /* Empty frame - treat as another opening END */
+                dec->state = FN_SLIP_STATE_DATA;
+                continue;
+            }
+            /* End of packet */
+            dec->state = FN_SLIP_STATE_HUNT;
+            *consumed = i + 1;
+            return FN_SLIP_FRAME;
+        }
+        
+        if (dec->state == FN_SLIP_STATE_ESCAPE) {
+            if (b == SLIP_ESC_END) {
+                b = SLIP_END;
+            } else if (b == SLIP_ESC_ESC) {
+                b = SLIP_ESCAPE;
+            }
+            /* Unknown escape - keep the byte (matches fn_slip_decode) */
+            dec->state = FN_SLIP_STATE_DATA;
+        } else if (b == SLIP_ESCAPE) {
+            dec->state = FN_SLIP_STATE_ESCAPE;
+            continue;
+        }
+        
+        if (dec->len >= dec->out_max) {
+            dec->state = FN_SLIP_STATE_HUNT;
+            *consumed = i + 1;
+            return FN_SLIP_OVERFLOW;
+        }
+        dec->out[dec->len++] = b;
+        
+        if (dec->len == dec->expect) {
+            /* Length-delimited frame is complete */
+            dec->state = FN_SLIP_STATE_HUNT;
+            *consumed = i + 1;
+            return FN_SLIP_FRAME;
+        }
+    }
+    
+    *consumed = in_len;
+    return FN_SLIP_MORE;
+}
+
 /**
  * Calculate the maximum encoded size for a given input size.
  * 
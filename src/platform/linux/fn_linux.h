@@ -0,0 +1,70 @@
+/*
+ * fn_linux.h - Linux transport internals
+ *
+ * Shared between the translation units of the Linux transport. Not part
+ * of the library API.
+ */
+
+#ifndef FN_LINUX_H
+#define FN_LINUX_H
+
+#include <stdint.h>
+
+#include "fn_protocol.h"
+
+/*
+ * io_uring backend (fn_uring.c)
+ *
+ * Enabled with FN_IO_URING=1. One exchange is a single io_uring_enter():
+ * the SLIP-encoded request is written and the first reply bytes read by
+ * linked requests, with a linked timeout on the read. The transport's two
+ * arenas (SLIP-encoded request out, raw reply bytes in) are registered
+ * with the kernel, so they are not mapped on every call.
+ */
+
+/*
+ * Set up the ring and register the arenas and the link's fd. The arenas
+ * must stay allocated until fn_uring_close(); to resize them, close and
+ * open again. Returns FN_OK, or FN_ERR_UNSUPPORTED if io_uring is
+ * unavailable.
+ */
+uint8_t fn_uring_open(int fd, uint8_t is_socket,
+                      uint8_t *tx, uint32_t tx_size,
+                      uint8_t *rx, uint32_t rx_size);
+
+/* Tear down the ring (safe to call when not open) */
+void fn_uring_close(void);
+
+/* Non-zero once fn_uring_open() has succeeded */
+uint8_t fn_uring_active(void);
+
+/*
+ * Write tx_len bytes from the tx arena (0 to only read), then wait up to
+ * timeout_ms for reply bytes in the rx arena. Returns the number of bytes
+ * read, 0 at end of file, -ETIME on timeout, or another negative errno.
+ */
+int fn_uring_exchange(uint32_t tx_len, unsigned long timeout_ms);
+
+/*
+ * Serial settings beyond POSIX termios (fn_serial.c)
+ *
+ * Each returns 0 on success or -1 with errno set. They apply on top of
+ * whatever tcsetattr() last set, so call them after it.
+ */
+
+/* Set any baud rate with termios2/BOTHER */
+int fn_serial_set_baud(int fd, int baud);
+
+/* Turn on RTS/CTS hardware flow control */
+int fn_serial_set_rtscts(int fd);
+
+/* Get the driver's serial_struct flags, or -1 */
+int fn_serial_get_flags(int fd);
+
+/* Put back serial_struct flags read by fn_serial_get_flags() */
+int fn_serial_set_flags(int fd, int flags);
+
+/* Set or clear ASYNC_LOW_LATENCY (no receive batching in the driver) */
+int fn_serial_set_low_latency(int fd, int on);
+
+#endif /* FN_LINUX_H */
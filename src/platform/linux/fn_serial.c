@@ -0,0 +1,78 @@
+/*
+ * fn_serial.c - Linux serial port settings beyond POSIX termios
+ *
+ * Arbitrary baud rates need the kernel's termios2 and BOTHER, which come
+ * from <asm/termbits.h>. That header clashes with glibc's <termios.h>,
+ * so these helpers live in their own translation unit.
+ */
+
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
+
+#include "fn_linux.h"
+
+int fn_serial_set_baud(int fd, int baud) {
+    struct termios2 tio;
+    
+    if (ioctl(fd, TCGETS2, &tio) < 0) {
+        return -1;
+    }
+    
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = (speed_t)baud;
+    tio.c_ospeed = (speed_t)baud;
+    
+    return ioctl(fd, TCSETS2, &tio);
+}
+
+int fn_serial_set_rtscts(int fd) {
+    struct termios2 tio;
+    
+    if (ioctl(fd, TCGETS2, &tio) < 0) {
+        return -1;
+    }
+    
+    tio.c_cflag |= CRTSCTS;
+    
+    return ioctl(fd, TCSETS2, &tio);
+}
+
+int fn_serial_get_flags(int fd) {
+    struct serial_struct ss;
+    
+    if (ioctl(fd, TIOCGSERIAL, &ss) < 0) {
+        return -1;
+    }
+    return ss.flags;
+}
+
+int fn_serial_set_flags(int fd, int flags) {
+    struct serial_struct ss;
+    
+    if (ioctl(fd, TIOCGSERIAL, &ss) < 0) {
+        return -1;
+    }
+    
+    ss.flags = flags;
+    
+    return ioctl(fd, TIOCSSERIAL, &ss);
+}
+
+int fn_serial_set_low_latency(int fd, int on) {
+    struct serial_struct ss;
+    
+    if (ioctl(fd, TIOCGSERIAL, &ss) < 0) {
+        return -1;
+    }
+    
+    if (on) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+    } else {
+        ss.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    
+    return ioctl(fd, TIOCSSERIAL, &ss);
+}
@@ -1,18 +1,27 @@
 /*
  * fn_transport.c - Linux/POSIX Transport Implementation
  *
- * Uses termios serial I/O to communicate with fujinet-nio.
- * Can connect to:
+ * Uses termios serial I/O or a stream socket to communicate with
+ * fujinet-nio. Can connect to:
  *   - Real serial ports (e.g., /dev/ttyUSB0 for ESP32)
  *   - PTY devices (for POSIX fujinet-nio)
+ *   - Unix-domain or TCP sockets (for POSIX fujinet-nio on the same host)
  *
  * Usage:
  *   Set FN_PORT environment variable to the device path, e.g.:
  *   FN_PORT=/dev/ttyUSB0 ./my_app
  *   FN_PORT=/dev/pts/2 ./my_app
+ *   FN_PORT=unix:/run/fujinet.sock ./my_app
+ *   FN_PORT=tcp://127.0.0.1:1985 ./my_app
+ *
+ *   FN_IO_URING=1 exchanges through io_uring (fn_uring.c) where the
+ *   kernel allows it, falling back to select() otherwise.
+ *
+ * Buffers start at the default frame size and grow when fn_init() agrees
+ * on larger frames with the device (up to 64 KiB).
  */
 
-#define _POSIX_C_SOURCE 199309L  /* For nanosleep */
+#define _POSIX_C_SOURCE 200809L  /* For clock_gettime, getaddrinfo, MSG_NOSIGNAL */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,51 +32,490 @@
 #include <errno.h>
 #include <time.h>
 #include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include "fujinet-nio.h"
 #include "fn_platform.h"
 #include "fn_protocol.h"
 #include "fn_internal.h"
+#include "fn_linux.h"
 
 /* Default serial port */
 #define DEFAULT_PORT    "/dev/ttyUSB0"
 #define DEFAULT_BAUD    115200
 
+/* Socket URL schemes accepted in FN_PORT */
+#define SCHEME_UNIX     "unix:"
+#define SCHEME_TCP      "tcp://"
+
+/*
+ * Receive deadlines (milliseconds). Requests the library will retransmit
+ * or can do without (fn_exchange_adaptive) wait for an adaptive timeout
+ * derived from measured round trips; everything else waits
+ * FN_TRANSPORT_TIMEOUT.
+ */
+#define RTO_INIT_MS     1000
+#define RTO_MIN_MS      100
+
+/* Socket connect timeout (milliseconds) */
+#define CONNECT_TIMEOUT_MS 2000
+
+/*
+ * Largest request slice SLIP-encoded at once: fn_slip_encode() counts in
+ * 16 bits, and the worst case doubles the data.
+ */
+#define TX_SLICE        ((FN_FRAME_SIZE_LIMIT - 2) / 2)
+
+/* Entries gathered for one writev() */
+#define SG_IOV_MAX      64
+
+/*
+ * Clean runs (no END or ESCAPE) at least SG_RUN_MIN long are written from
+ * the caller's memory. Anything else is escaped into _tx_buf up to
+ * SG_STAGE bytes at a time: bigger pieces scan dense data once, not once
+ * per short run. _tx_buf always holds a piece escaped (TX_SLICE or more).
+ */
+#define SG_RUN_MIN      256
+#define SG_STAGE        4096
+
 /* Module state */
 static int _fd = -1;
+static uint8_t _is_tty = 0;
+static int _saved_serial_flags = -1;     /* Set only if we changed them */
 static struct termios _saved_termios;
 
-/* Baud rate lookup */
+/* Round-trip estimate for the link (RFC 6298), milliseconds */
+static uint8_t _rtt_valid = 0;
+static unsigned long _srtt8;    /* Smoothed RTT, scaled by 8 */
+static unsigned long _rttvar4;  /* RTT mean deviation, scaled by 4 */
+static unsigned long _rto = RTO_INIT_MS;
+
+/* Largest frame agreed for the link, and buffers sized for it */
+static uint16_t _max_frame = 0;
+static uint8_t *_tx_buf = NULL;     /* SLIP-encoded request (slice) */
+static uint32_t _tx_size = 0;
+
+/*
+ * Raw bytes received past the end of the last frame (pipelined responses).
+ * Also the io_uring read arena, so nothing is copied to keep them.
+ */
+static uint8_t *_rx_stash = NULL;
+static uint16_t _rx_size = 0;
+static uint16_t _rx_pos = 0;
+static uint16_t _rx_len = 0;
+
+/* Caller's transport buffer (fn_init_ex()), and whether the link buffers are in it */
+static uint8_t *_user_buf = NULL;
+static size_t _user_size = 0;
+static uint8_t _in_user_buf = 0;
+
+/* Frame being received by the non-blocking poll */
+static fn_slip_decoder_t _poll_dec;
+static uint8_t _poll_active = 0;
+static unsigned long _poll_deadline;
+
+/* Monotonic clock in milliseconds */
+static unsigned long _now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000UL + (unsigned long)(ts.tv_nsec / 1000000L);
+}
+
+/* The same clock for the library's own delays (FN_PLATFORM_MS()) */
+uint16_t fn_platform_ms(void) {
+    return (uint16_t)_now_ms();
+}
+
+/* Keep the retransmission timeout within bounds */
+static void _rto_clamp(void) {
+    if (_rto < RTO_MIN_MS) {
+        _rto = RTO_MIN_MS;
+    }
+    if (_rto > FN_TRANSPORT_TIMEOUT) {
+        _rto = FN_TRANSPORT_TIMEOUT;
+    }
+}
+
+/*
+ * Fold a measured round trip into the estimate:
+ * SRTT += (RTT - SRTT) / 8, RTTVAR += (|RTT - SRTT| - RTTVAR) / 4,
+ * RTO = SRTT + 4 * RTTVAR.
+ */
+static void _rtt_sample(unsigned long rtt) {
+    unsigned long err;
+    
+    if (!_rtt_valid) {
+        _srtt8 = rtt << 3;
+        _rttvar4 = rtt << 1;
+        _rtt_valid = 1;
+    } else {
+        err = rtt > (_srtt8 >> 3) ? rtt - (_srtt8 >> 3) : (_srtt8 >> 3) - rtt;
+        _srtt8 = _srtt8 - (_srtt8 >> 3) + rtt;
+        _rttvar4 = _rttvar4 - (_rttvar4 >> 2) + err;
+    }
+    _rto = (_srtt8 >> 3) + _rttvar4;
+    _rto_clamp();
+}
+
+/* After a timeout, back off until a fresh sample arrives */
+static void _rtt_backoff(void) {
+    _rto <<= 1;
+    _rto_clamp();
+}
+
+/*
+ * Check the FujiBus length field once the first 4 bytes are decoded.
+ * Returns FN_OK and sets dec->expect, or FN_ERR_INVALID for a length that
+ * cannot be right (shorter than a header, larger than the buffer, or
+ * already exceeded).
+ */
+static uint8_t _expect_length(fn_slip_decoder_t *dec) {
+    uint16_t pkt_len;
+    
+    pkt_len = dec->out[2] | (dec->out[3] << 8);
+    if (pkt_len < FN_HEADER_SIZE || pkt_len > dec->out_max || pkt_len < dec->len) {
+        return FN_ERR_INVALID;
+    }
+    dec->expect = pkt_len;
+    return FN_OK;
+}
+
+/* Baud rate lookup; B0 means a non-standard rate (set with BOTHER) */
 static speed_t _get_baud(int baud) {
     switch (baud) {
-        case 9600:   return B9600;
-        case 19200:  return B19200;
-        case 38400:  return B38400;
-        case 57600:  return B57600;
-        case 115200: return B115200;
-        case 230400: return B230400;
-        default:     return B115200;
+        case 9600:    return B9600;
+        case 19200:   return B19200;
+        case 38400:   return B38400;
+        case 57600:   return B57600;
+        case 115200:  return B115200;
+        case 230400:  return B230400;
+#ifdef B4000000
+        case 460800:  return B460800;
+        case 500000:  return B500000;
+        case 576000:  return B576000;
+        case 921600:  return B921600;
+        case 1000000: return B1000000;
+        case 1152000: return B1152000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        case 2500000: return B2500000;
+        case 3000000: return B3000000;
+        case 3500000: return B3500000;
+        case 4000000: return B4000000;
+#endif
+        default:      return B0;
     }
 }
 
 /*
- * Initialize the transport.
- * Opens the serial port specified by FN_PORT env var, or /dev/ttyUSB0.
+ * Connect a non-blocking socket, waiting at most CONNECT_TIMEOUT_MS.
+ * Returns 0 on success, -1 on failure (errno set).
  */
-uint8_t fn_transport_init(void) {
+static int _connect_deadline(int fd, const struct sockaddr *addr, socklen_t addr_len) {
+    fd_set write_fds;
+    struct timeval tv;
+    int err;
+    socklen_t err_len;
+    
+    if (connect(fd, addr, addr_len) == 0) {
+        return 0;
+    }
+    if (errno != EINPROGRESS) {
+        return -1;
+    }
+    
+    FD_ZERO(&write_fds);
+    FD_SET(fd, &write_fds);
+    tv.tv_sec = CONNECT_TIMEOUT_MS / 1000;
+    tv.tv_usec = (CONNECT_TIMEOUT_MS % 1000) * 1000;
+    if (select(fd + 1, NULL, &write_fds, NULL, &tv) <= 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    
+    err_len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) < 0) {
+        return -1;
+    }
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Open a Unix-domain socket: "unix:/path/to/socket".
+ */
+static int _open_unix(const char *path) {
+    struct sockaddr_un sun;
+    int fd;
+    
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+    
+    if (_connect_deadline(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Open a TCP socket: "tcp://host:port" (IPv6 hosts in brackets).
+ */
+static int _open_tcp(const char *spec) {
+    char host[256];
     const char *port;
-    const char *baud_str;
-    int baud;
-    struct termios tio;
+    const char *end;
+    size_t host_len;
+    struct addrinfo hints;
+    struct addrinfo *res;
+    struct addrinfo *ai;
+    int fd;
+    int one;
     
-    if (_fd >= 0) {
-        return FN_OK;  /* Already initialized */
+    /* Split host and port */
+    if (spec[0] == '[') {
+        end = strchr(spec, ']');
+        if (end == NULL || end[1] != ':') {
+            errno = EINVAL;
+            return -1;
+        }
+        spec++;
+        port = end + 2;
+    } else {
+        end = strrchr(spec, ':');
+        if (end == NULL) {
+            errno = EINVAL;
+            return -1;
+        }
+        port = end + 1;
+    }
+    host_len = (size_t)(end - spec);
+    if (host_len == 0 || host_len >= sizeof(host) || port[0] == '\0') {
+        errno = EINVAL;
+        return -1;
     }
+    memcpy(host, spec, host_len);
+    host[host_len] = '\0';
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+    
+    fd = -1;
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        if (_connect_deadline(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    
+    if (fd >= 0) {
+        /* Packets are small request/response pairs - don't let Nagle hold them */
+        one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/*
+ * Size the link buffers for frames up to max_frame bytes, in the caller's
+ * transport buffer when they fit there. The io_uring arenas are
+ * registered again at their new addresses. On failure the old buffers
+ * are kept.
+ */
+static uint8_t _set_max_frame(uint16_t max_frame) {
+    uint8_t *tx;
+    uint8_t *rx;
+    uint32_t tx_size;
+    uint8_t in_user;
+    uint8_t uring;
+    
+    tx_size = (uint32_t)(max_frame < TX_SLICE ? max_frame : TX_SLICE) * 2 + 2;
+    in_user = _user_buf != NULL && tx_size + max_frame <= _user_size;
+    if (in_user) {
+        tx = _user_buf;
+        rx = _user_buf + tx_size;
+    } else {
+        tx = malloc(tx_size);
+        rx = malloc(max_frame);
+        if (tx == NULL || rx == NULL) {
+            free(tx);
+            free(rx);
+            return FN_ERR_INTERNAL;
+        }
+    }
+    
+    uring = fn_uring_active();
+    fn_uring_close();
+    
+    if (!_in_user_buf) {
+        free(_tx_buf);
+        free(_rx_stash);
+    }
+    _tx_buf = tx;
+    _tx_size = tx_size;
+    _rx_stash = rx;
+    _rx_size = max_frame;
+    _rx_pos = 0;
+    _rx_len = 0;
+    _max_frame = max_frame;
+    _in_user_buf = in_user;
+    
+    if (uring && fn_uring_open(_fd, !_is_tty, _tx_buf, _tx_size, _rx_stash, _rx_size) != FN_OK) {
+        fprintf(stderr, "fn_transport: io_uring unavailable, using select()\n");
+    }
+    return FN_OK;
+}
+
+/*
+ * Take the caller's transport buffer (NULL for none). Used from the next
+ * time the link buffers are sized.
+ */
+static uint8_t _set_buffer(uint8_t *buf, size_t size) {
+    _user_buf = buf;
+    _user_size = buf != NULL ? size : 0;
+    return FN_OK;
+}
+
+/*
+ * Switch exchanges to io_uring if FN_IO_URING=1 asks for it.
+ */
+static void _use_uring(void) {
+    const char *env;
+    
+    env = getenv("FN_IO_URING");
+    if (env == NULL || strcmp(env, "1") != 0) {
+        return;
+    }
+    if (fn_uring_open(_fd, !_is_tty, _tx_buf, _tx_size, _rx_stash, _rx_size) != FN_OK) {
+        fprintf(stderr, "fn_transport: io_uring unavailable, using select()\n");
+    }
+}
+
+/*
+ * Release the link buffers.
+ */
+static void _free_buffers(void) {
+    if (!_in_user_buf) {
+        free(_tx_buf);
+        free(_rx_stash);
+    }
+    _in_user_buf = 0;
+    _tx_buf = NULL;
+    _tx_size = 0;
+    _rx_stash = NULL;
+    _rx_size = 0;
+    _rx_pos = 0;
+    _rx_len = 0;
+    _max_frame = 0;
+}
+
+/*
+ * Initialize a socket transport. No termios, no baud rate.
+ */
+static uint8_t _init_socket(const char *port) {
+    if (strncmp(port, SCHEME_UNIX, sizeof(SCHEME_UNIX) - 1) == 0) {
+        _fd = _open_unix(port + sizeof(SCHEME_UNIX) - 1);
+    } else {
+        _fd = _open_tcp(port + sizeof(SCHEME_TCP) - 1);
+    }
+    
+    if (_fd < 0) {
+        fprintf(stderr, "fn_transport: cannot connect to %s: %s\n", port, strerror(errno));
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    _is_tty = 0;
+    if (_set_max_frame(FN_MAX_PACKET_SIZE) != FN_OK) {
+        close(_fd);
+        _fd = -1;
+        return FN_ERR_INTERNAL;
+    }
+    _use_uring();
+    return FN_OK;
+}
+
+/*
+ * Discard any unread input, e.g. a late response to a timed-out request.
+ */
+static void _discard_input(void) {
+    uint8_t junk[256];
+    
+    _rx_pos = 0;
+    _rx_len = 0;
+    _poll_active = 0;
+    
+    if (_is_tty) {
+        tcflush(_fd, TCIFLUSH);
+        return;
+    }
+    while (read(_fd, junk, sizeof(junk)) > 0) {
+        /* Drain until EAGAIN (or EOF, which the next read will report) */
+    }
+}
+
+/*
+ * Get the port named by the FN_PORT env var, or /dev/ttyUSB0.
+ */
+static const char *_get_port(void) {
+    const char *port;
     
     port = getenv("FN_PORT");
     if (port == NULL || port[0] == '\0') {
         port = DEFAULT_PORT;
     }
+    return port;
+}
+
+/*
+ * Check whether a port names a socket rather than a device.
+ */
+static uint8_t _is_socket_port(const char *port) {
+    return strncmp(port, SCHEME_UNIX, sizeof(SCHEME_UNIX) - 1) == 0 ||
+           strncmp(port, SCHEME_TCP, sizeof(SCHEME_TCP) - 1) == 0;
+}
+
+/*
+ * Initialize a serial/PTY transport.
+ */
+static uint8_t _init_serial(const char *port) {
+    const char *baud_str;
+    const char *env;
+    int baud;
+    int flags;
+    speed_t speed;
+    struct termios tio;
     
     baud_str = getenv("FN_BAUD");
     if (baud_str != NULL && baud_str[0] != '\0') {
@@ -99,9 +547,10 @@ uint8_t fn_transport_init(void) {
     tio.c_oflag = 0;  /* No output processing */
     tio.c_lflag = 0;  /* No local modes (no echo, no signals) */
     
-    /* Set baud rate */
-    cfsetispeed(&tio, _get_baud(baud));
-    cfsetospeed(&tio, _get_baud(baud));
+    /* Set baud rate (a placeholder for non-standard rates, see below) */
+    speed = _get_baud(baud);
+    cfsetispeed(&tio, speed != B0 ? speed : B38400);
+    cfsetospeed(&tio, speed != B0 ? speed : B38400);
     
     /* Timeout: 0.1 seconds (VTIME in deciseconds) */
     tio.c_cc[VMIN] = 0;
@@ -114,12 +563,65 @@ uint8_t fn_transport_init(void) {
         return FN_ERR_IO;
     }
     
+    /* Rates without a Bnnn constant go through termios2/BOTHER */
+    if (speed == B0 && fn_serial_set_baud(_fd, baud) < 0) {
+        fprintf(stderr, "fn_transport: cannot set %d baud: %s\n", baud, strerror(errno));
+        tcsetattr(_fd, TCSANOW, &_saved_termios);
+        close(_fd);
+        _fd = -1;
+        return FN_ERR_IO;
+    }
+    
+    /* FN_FLOW=rtscts: hardware flow control, so high rates don't drop bytes */
+    env = getenv("FN_FLOW");
+    if (env != NULL && strcmp(env, "rtscts") == 0) {
+        if (fn_serial_set_rtscts(_fd) < 0) {
+            fprintf(stderr, "fn_transport: cannot enable RTS/CTS: %s\n", strerror(errno));
+        }
+    }
+    
+    /* FN_LOW_LATENCY=1: the driver hands over bytes without batching */
+    env = getenv("FN_LOW_LATENCY");
+    if (env != NULL && strcmp(env, "1") == 0) {
+        flags = fn_serial_get_flags(_fd);
+        if (flags < 0 || fn_serial_set_low_latency(_fd, 1) < 0) {
+            fprintf(stderr, "fn_transport: cannot enable low latency: %s\n", strerror(errno));
+        } else {
+            _saved_serial_flags = flags;
+        }
+    }
+    
     /* Flush any pending data */
     tcflush(_fd, TCIOFLUSH);
     
+    _is_tty = 1;
+    if (_set_max_frame(FN_MAX_PACKET_SIZE) != FN_OK) {
+        fn_transport_close();
+        return FN_ERR_INTERNAL;
+    }
+    _use_uring();
     return FN_OK;
 }
 
+/*
+ * Initialize the transport.
+ * Connects to the socket or opens the serial port specified by the FN_PORT
+ * env var, or /dev/ttyUSB0.
+ */
+uint8_t fn_transport_init(void) {
+    const char *port;
+    
+    if (_fd >= 0) {
+        return FN_OK;  /* Already initialized */
+    }
+    
+    port = _get_port();
+    if (_is_socket_port(port)) {
+        return _init_socket(port);
+    }
+    return _init_serial(port);
+}
+
 /*
  * Check if transport is ready for communication.
  */
@@ -131,160 +633,767 @@ uint8_t fn_transport_ready(void) {
 }
 
 /*
- * Exchange a FujiBus packet with the device.
- * Sends the request packet and receives the response.
- * 
- * request: FujiBus request packet (not SLIP-encoded)
- * req_len: length of request packet
- * response: buffer for response packet (SLIP-decoded)
- * resp_max: maximum response buffer size
- * resp_len: pointer to receive actual response length
- *
- * Returns: FN_OK on success, error code on failure
+ * Write all of iov[0..count), waiting for the link to drain if it is full.
+ * Sockets use MSG_NOSIGNAL so a dropped peer shows up as EPIPE instead of
+ * killing the process with SIGPIPE. The entries are advanced past what
+ * has been written.
  */
-uint8_t fn_transport_exchange(const uint8_t *request,
-                               uint16_t req_len,
-                               uint8_t *response,
-                               uint16_t resp_max,
-                               uint16_t *resp_len) {
+static uint8_t _writev_all(struct iovec *iov, int count) {
+    struct msghdr msg;
     ssize_t n;
-    uint16_t total;
-    uint16_t timeout_ms;
-    fd_set read_fds;
     fd_set write_fds;
     struct timeval tv;
-    int ret;
-    uint8_t slip_buf[1024];
-    uint16_t slip_len;
-    uint8_t raw_buf[1024];
-    uint16_t raw_len;
     
-    (void)resp_max;  /* Suppress unused parameter warning */
+    while (count > 0) {
+        if (count == 1) {
+            /* Most frames are staged whole: plain write()/send() is cheaper */
+            n = _is_tty ? write(_fd, iov->iov_base, iov->iov_len)
+                        : send(_fd, iov->iov_base, iov->iov_len, MSG_NOSIGNAL);
+        } else if (_is_tty) {
+            n = writev(_fd, iov, count);
+        } else {
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = (size_t)count;
+            n = sendmsg(_fd, &msg, MSG_NOSIGNAL);
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                /* Wait for write ready */
+                FD_ZERO(&write_fds);
+                FD_SET(_fd, &write_fds);
+                tv.tv_sec = FN_TRANSPORT_TIMEOUT / 1000;
+                tv.tv_usec = (FN_TRANSPORT_TIMEOUT % 1000) * 1000;
+                if (select(_fd + 1, NULL, &write_fds, NULL, &tv) <= 0) {
+                    fprintf(stderr, "fn_transport: write timeout\n");
+                    return FN_ERR_IO;
+                }
+                continue;
+            }
+            fprintf(stderr, "fn_transport: write error: %s\n", strerror(errno));
+            return FN_ERR_IO;
+        }
+        
+        /* Skip the entries written, and the written part of the next */
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    
+    return FN_OK;
+}
+
+/*
+ * Write all of buf, waiting for the link to drain if it is full.
+ */
+static uint8_t _write_all(const uint8_t *buf, uint32_t len) {
+    struct iovec iov;
+    
+    iov.iov_base = (void *)buf;
+    iov.iov_len = len;
+    return _writev_all(&iov, 1);
+}
+
+/* Frame being gathered by _send_segments() */
+typedef struct {
+    struct iovec iov[SG_IOV_MAX];
+    int count;
+    uint32_t staged;    /* Bytes of _tx_buf in use */
+    uint32_t mark;      /* Start of the staged bytes not yet in iov */
+} sg_frame_t;
+
+/* End the iov entry being staged in _tx_buf, if there is one */
+static void _sg_close(sg_frame_t *sg) {
+    if (sg->staged > sg->mark) {
+        sg->iov[sg->count].iov_base = _tx_buf + sg->mark;
+        sg->iov[sg->count].iov_len = sg->staged - sg->mark;
+        sg->count++;
+        sg->mark = sg->staged;
+    }
+}
+
+/* Write everything gathered so far and start again with an empty _tx_buf */
+static uint8_t _sg_flush(sg_frame_t *sg) {
+    uint8_t result;
+    
+    _sg_close(sg);
+    result = _writev_all(sg->iov, sg->count);
+    sg->count = 0;
+    sg->staged = 0;
+    sg->mark = 0;
+    return result;
+}
+
+/*
+ * SLIP-encode and send one request packet given as segments.
+ *
+ * The frame is streamed: long clean runs go to writev() straight from the
+ * segments, while END markers, escaped bytes and short runs are staged in
+ * _tx_buf. Whatever the frame size, the packet is never copied whole, and
+ * _tx_buf is flushed and reused whenever it (or the iov list) fills.
+ */
+static uint8_t _send_segments(const fn_segment_t *segs, uint8_t count) {
+    sg_frame_t sg;
+    const uint8_t *p;
+    uint32_t total;
+    uint16_t left;
+    uint16_t run;
+    uint16_t n;
+    uint8_t i;
+    uint8_t result;
     
     if (_fd < 0) {
         return FN_ERR_NOT_FOUND;
     }
     
-    if (request == NULL || req_len == 0 || response == NULL || resp_len == NULL) {
+    total = 0;
+    for (i = 0; i < count; i++) {
+        if (segs[i].data == NULL && segs[i].len > 0) {
+            return FN_ERR_INVALID;
+        }
+        total += segs[i].len;
+    }
+    if (total == 0 || total > _max_frame) {
+        return FN_ERR_INVALID;
+    }
+    
+    sg.count = 0;
+    sg.staged = 0;
+    sg.mark = 0;
+    _tx_buf[sg.staged++] = SLIP_END;
+    
+    for (i = 0; i < count; i++) {
+        p = segs[i].data;
+        left = segs[i].len;
+        while (left > 0) {
+            run = fn_slip_scan(p, left);
+            if (run >= SG_RUN_MIN) {
+                /* Room for this entry, the staged one and the closing END's */
+                if (sg.count >= SG_IOV_MAX - 2) {
+                    result = _sg_flush(&sg);
+                    if (result != FN_OK) {
+                        return result;
+                    }
+                }
+                _sg_close(&sg);
+                sg.iov[sg.count].iov_base = (void *)p;
+                sg.iov[sg.count].iov_len = run;
+                sg.count++;
+                p += run;
+                left -= run;
+                continue;
+            }
+            
+            n = left < SG_STAGE ? left : SG_STAGE;
+            if (_tx_size - sg.staged < (uint32_t)n * 2 + 1) {
+                result = _sg_flush(&sg);
+                if (result != FN_OK) {
+                    return result;
+                }
+            }
+            sg.staged += fn_slip_escape(p, n, _tx_buf + sg.staged);
+            p += n;
+            left -= n;
+        }
+    }
+    
+    _tx_buf[sg.staged++] = SLIP_END;
+    return _sg_flush(&sg);
+}
+
+/*
+ * SLIP-encode and send one request packet.
+ */
+static uint8_t _send_frame(const uint8_t *request, uint16_t req_len) {
+    fn_segment_t seg;
+    
+    if (request == NULL) {
         return FN_ERR_INVALID;
     }
+    seg.data = request;
+    seg.len = req_len;
+    return _send_segments(&seg, 1);
+}
+
+/*
+ * Decode n raw bytes (which may sit at the free tail of the response
+ * buffer). Sets *done once the frame is complete; *used is how many raw
+ * bytes were consumed (the rest belong to the next frame).
+ */
+static uint8_t _feed(fn_slip_decoder_t *dec, const uint8_t *input, uint16_t n,
+                     uint16_t *used, uint8_t *done) {
+    uint8_t status;
     
-    /* SLIP-encode the request */
-    slip_len = fn_slip_encode(request, req_len, slip_buf);
-    if (slip_len == 0) {
+    status = fn_slip_decoder_feed(dec, input, n, used);
+    if (status == FN_SLIP_FRAME) {
+        *done = 1;
+        return FN_OK;
+    }
+    if (status == FN_SLIP_OVERFLOW) {
+        fprintf(stderr, "fn_transport: response frame too large\n");
+        fn_frame_damaged = 1;
         return FN_ERR_IO;
     }
     
-    /* Send the SLIP-encoded request */
-    total = 0;
-    while (total < slip_len) {
-        n = write(_fd, slip_buf + total, slip_len - total);
+    /* Learn the packet length as soon as the header has arrived */
+    if (dec->expect == 0 && dec->len >= 4) {
+        if (_expect_length(dec) != FN_OK) {
+            fprintf(stderr, "fn_transport: bad response length\n");
+            fn_frame_damaged = 1;
+            return FN_ERR_INVALID;
+        }
+        if (dec->len == dec->expect) {
+            *done = 1;
+        }
+    }
+    return FN_OK;
+}
+
+/*
+ * Decode bytes left over from the previous frame. Any that follow the
+ * frame stay stashed; once the stash is used up it is emptied.
+ */
+static uint8_t _rx_stashed(fn_slip_decoder_t *dec, uint8_t *done) {
+    uint16_t chunk;
+    uint16_t used;
+    uint8_t result;
+    
+    while (_rx_pos < _rx_len) {
+        if (dec->len >= dec->out_max) {
+            fprintf(stderr, "fn_transport: response frame too large\n");
+            fn_frame_damaged = 1;
+            return FN_ERR_IO;
+        }
+        chunk = _rx_len - _rx_pos;
+        if (chunk > dec->out_max - dec->len) {
+            chunk = dec->out_max - dec->len;
+        }
+        memcpy(dec->out + dec->len, _rx_stash + _rx_pos, chunk);
+        result = _feed(dec, dec->out + dec->len, chunk, &used, done);
+        if (result != FN_OK) {
+            return result;
+        }
+        _rx_pos += used;
+        if (*done) {
+            return FN_OK;
+        }
+    }
+    _rx_pos = 0;
+    _rx_len = 0;
+    return FN_OK;
+}
+
+/*
+ * Read and decode whatever has arrived, without waiting. Returns FN_OK
+ * with *done clear when the link has no more bytes for now.
+ *
+ * Raw bytes are read straight into the unused tail of the response buffer
+ * and decoded in place. With several requests in flight, one read() can
+ * also pick up the start of the next response; those bytes are kept in
+ * _rx_stash and decoded first next time.
+ */
+static uint8_t _rx_available(fn_slip_decoder_t *dec, uint8_t *done) {
+    ssize_t n;
+    size_t room;
+    uint16_t start;
+    uint16_t used;
+    uint8_t result;
+    
+    for (;;) {
+        if (dec->len >= dec->out_max) {
+            fprintf(stderr, "fn_transport: response frame too large\n");
+            fn_frame_damaged = 1;
+            return FN_ERR_IO;
+        }
+        
+        /* Read no more than the stash could hold if it overshoots */
+        room = dec->out_max - dec->len;
+        if (room > _rx_size) {
+            room = _rx_size;
+        }
+        
+        start = dec->len;
+        n = read(_fd, dec->out + start, room);
         if (n < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                /* Wait for write ready */
-                FD_ZERO(&write_fds);
-                FD_SET(_fd, &write_fds);
-                tv.tv_sec = 1;
-                tv.tv_usec = 0;
-                if (select(_fd + 1, NULL, &write_fds, NULL, &tv) <= 0) {
-                    fprintf(stderr, "fn_transport: write timeout\n");
-                    return FN_ERR_IO;
-                }
+            if (errno == EINTR) {
                 continue;
             }
-            fprintf(stderr, "fn_transport: write error: %s\n", strerror(errno));
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FN_OK;
+            }
+            fprintf(stderr, "fn_transport: read error: %s\n", strerror(errno));
+            return FN_ERR_IO;
+        }
+        if (n == 0) {
+            /* EOF (PTY or socket closed) */
+            fprintf(stderr, "fn_transport: EOF\n");
             return FN_ERR_IO;
         }
-        total += (uint16_t)n;
+        
+        result = _feed(dec, dec->out + start, (uint16_t)n, &used, done);
+        if (result != FN_OK) {
+            return result;
+        }
+        if (*done) {
+            /* Keep whatever followed the frame for the next receive */
+            _rx_len = (uint16_t)n - used;
+            memcpy(_rx_stash, dec->out + start + used, _rx_len);
+            return FN_OK;
+        }
     }
+}
+
+/*
+ * Receive one SLIP-framed response packet.
+ *
+ * There is no fixed settle delay: select() wakes us as soon as bytes
+ * arrive, and the receive ends the moment the decoder reports a complete
+ * frame. Once the header is in, the FujiBus length field tells us exactly
+ * where the frame ends, so we stop there rather than waiting for the
+ * closing END.
+ */
+static uint8_t _recv_timed(uint8_t *response, uint16_t resp_max, uint16_t *resp_len,
+                           unsigned long timeout_ms) {
+    fd_set read_fds;
+    struct timeval tv;
+    int ret;
+    fn_slip_decoder_t dec;
+    uint8_t done;
+    uint8_t result;
+    unsigned long now;
+    unsigned long deadline;
     
-    /* Make sure data is sent */
-    tcdrain(_fd);
-    
-    /* Flush any pending input (e.g., echoes) */
-    tcflush(_fd, TCIFLUSH);
+    if (_fd < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
     
-    /* Small delay to allow device to process request */
-    {
-        struct timespec ts;
-        ts.tv_sec = 0;
-        ts.tv_nsec = 10000000;  /* 10ms */
-        nanosleep(&ts, NULL);
+    if (response == NULL || resp_len == NULL) {
+        return FN_ERR_INVALID;
     }
     
-    /* Receive the SLIP-encoded response with timeout */
-    raw_len = 0;
-    timeout_ms = 2000;  /* 2 second overall timeout */
+    fn_slip_decoder_init(&dec, response, resp_max);
+    done = 0;
     
-    while (raw_len < sizeof(raw_buf)) {
-        /* Wait for data */
+    result = _rx_stashed(&dec, &done);
+    deadline = _now_ms() + timeout_ms;
+    
+    while (result == FN_OK && !done) {
+        result = _rx_available(&dec, &done);
+        if (result != FN_OK || done) {
+            break;
+        }
+        
+        now = _now_ms();
+        if (now >= deadline) {
+            fprintf(stderr, "fn_transport: receive timeout\n");
+            return FN_ERR_TIMEOUT;
+        }
+        
+        /* Wait for data, but no longer than the remaining deadline */
         FD_ZERO(&read_fds);
         FD_SET(_fd, &read_fds);
-        tv.tv_sec = 0;
-        tv.tv_usec = 100000;  /* 100ms */
+        tv.tv_sec = (deadline - now) / 1000;
+        tv.tv_usec = ((deadline - now) % 1000) * 1000;
         ret = select(_fd + 1, &read_fds, NULL, NULL, &tv);
-        
-        if (ret < 0) {
+        if (ret < 0 && errno != EINTR) {
             fprintf(stderr, "fn_transport: select error\n");
             return FN_ERR_IO;
         }
-        if (ret == 0) {
-            /* Timeout - check if we have a complete SLIP frame */
-            /* A valid frame needs at least 2 END markers: C0 ... C0 */
-            if (raw_len >= 2 && raw_buf[0] == SLIP_END && raw_buf[raw_len - 1] == SLIP_END) {
-                /* We have a complete frame */
-                break;
+    }
+    
+    if (result != FN_OK) {
+        return result;
+    }
+    
+    *resp_len = dec.len;
+    
+    return FN_OK;
+}
+
+/*
+ * Receive the next pipelined response.
+ */
+static uint8_t _recv_frame(uint8_t *response, uint16_t resp_max, uint16_t *resp_len) {
+    return _recv_timed(response, resp_max, resp_len, FN_TRANSPORT_TIMEOUT);
+}
+
+/*
+ * Non-blocking receive for the asynchronous API: decode what has arrived
+ * and return FN_ERR_NOT_READY until the frame is complete. The decoder
+ * state carries over between calls; the receive deadline starts with the
+ * first call for a frame.
+ */
+static uint8_t _poll_frame(uint8_t *response, uint16_t resp_max, uint16_t *resp_len) {
+    uint8_t done;
+    uint8_t result;
+    
+    if (_fd < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    if (response == NULL || resp_len == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    done = 0;
+    result = FN_OK;
+    if (!_poll_active || _poll_dec.out != response) {
+        fn_slip_decoder_init(&_poll_dec, response, resp_max);
+        _poll_deadline = _now_ms() + FN_TRANSPORT_TIMEOUT;
+        _poll_active = 1;
+        result = _rx_stashed(&_poll_dec, &done);
+    }
+    
+    if (result == FN_OK && !done) {
+        result = _rx_available(&_poll_dec, &done);
+    }
+    
+    if (result == FN_OK && !done) {
+        if (_now_ms() < _poll_deadline) {
+            return FN_ERR_NOT_READY;
+        }
+        fprintf(stderr, "fn_transport: receive timeout\n");
+        result = FN_ERR_TIMEOUT;
+    }
+    
+    _poll_active = 0;
+    if (result == FN_OK) {
+        *resp_len = _poll_dec.len;
+    }
+    return result;
+}
+
+/*
+ * Exchange through io_uring. The request goes out with the first read, so
+ * each burst of reply bytes costs a single io_uring_enter(). With wire set,
+ * the request is already a SLIP frame (one segment) and is only copied to
+ * the registered buffer.
+ */
+static uint8_t _uring_exchange(const fn_segment_t *segs,
+                               uint8_t count,
+                               uint32_t req_len,
+                               uint8_t wire,
+                               uint8_t *response,
+                               uint16_t resp_max,
+                               uint16_t *resp_len,
+                               unsigned long timeout_ms) {
+    fn_slip_decoder_t dec;
+    uint32_t tx_len;
+    uint16_t used;
+    uint8_t done;
+    uint8_t result;
+    uint8_t i;
+    int n;
+    unsigned long now;
+    unsigned long deadline;
+    
+    if (wire) {
+        /* Frames too large for the registered buffer are written beforehand */
+        if (req_len <= _tx_size) {
+            memcpy(_tx_buf, segs[0].data, req_len);
+            tx_len = req_len;
+        } else {
+            result = _write_all(segs[0].data, req_len);
+            if (result != FN_OK) {
+                return result;
             }
-            /* If we have some data but not a complete frame, keep waiting */
-            timeout_ms -= 100;
-            if (timeout_ms == 0) {
-                fprintf(stderr, "fn_transport: receive timeout\n");
-                return FN_ERR_TIMEOUT;
+            tx_len = 0;
+        }
+    } else if (req_len > TX_SLICE) {
+        /* Requests too large to encode in one go are written beforehand */
+        result = _send_segments(segs, count);
+        if (result != FN_OK) {
+            return result;
+        }
+        tx_len = 0;
+    } else {
+        tx_len = 0;
+        _tx_buf[tx_len++] = SLIP_END;
+        for (i = 0; i < count; i++) {
+            if (segs[i].len > 0) {
+                tx_len += fn_slip_escape(segs[i].data, segs[i].len, _tx_buf + tx_len);
             }
-            continue;
+        }
+        _tx_buf[tx_len++] = SLIP_END;
+    }
+    
+    fn_slip_decoder_init(&dec, response, resp_max);
+    done = 0;
+    deadline = _now_ms() + timeout_ms;
+    
+    while (!done) {
+        now = _now_ms();
+        if (now >= deadline) {
+            fprintf(stderr, "fn_transport: receive timeout\n");
+            return FN_ERR_TIMEOUT;
         }
         
-        /* Read available data */
-        n = read(_fd, raw_buf + raw_len, sizeof(raw_buf) - raw_len);
+        n = fn_uring_exchange(tx_len, deadline - now);
+        if (n == -ETIME) {
+            tx_len = 0;
+            continue;  /* Deadline is checked at the top of the loop */
+        }
         if (n < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            }
-            fprintf(stderr, "fn_transport: read error: %s\n", strerror(errno));
+            fprintf(stderr, "fn_transport: io_uring error: %s\n", strerror(-n));
             return FN_ERR_IO;
         }
         if (n == 0) {
-            /* EOF (PTY closed) */
             fprintf(stderr, "fn_transport: EOF\n");
             return FN_ERR_IO;
         }
+        tx_len = 0;
         
-        raw_len += (uint16_t)n;
-        
-        /* Check for end of SLIP frame - need at least 2 bytes (C0 ... C0) */
-        if (raw_len >= 2 && raw_buf[raw_len - 1] == SLIP_END && raw_buf[0] == SLIP_END) {
-            break;
+        result = _feed(&dec, _rx_stash, (uint16_t)n, &used, &done);
+        if (result != FN_OK) {
+            return result;
+        }
+        if (done) {
+            /* Whatever followed the frame is already in the stash */
+            _rx_pos = used;
+            _rx_len = (uint16_t)n;
         }
     }
     
-    /* SLIP-decode the response */
-    *resp_len = fn_slip_decode(raw_buf, raw_len, response);
-    if (*resp_len == 0) {
-        fprintf(stderr, "fn_transport: SLIP decode failed\n");
-        return FN_ERR_IO;
-    }
+    *resp_len = dec.len;
     
     return FN_OK;
 }
 
+/*
+ * Send a request given as segments and receive the response. With wire
+ * set, the request is a single segment that is already a SLIP frame (END,
+ * escaped packet, END) and is sent as it is.
+ */
+static uint8_t _exchange(const fn_segment_t *segs,
+                         uint8_t count,
+                         uint8_t wire,
+                         uint8_t *response,
+                         uint16_t resp_max,
+                         uint16_t *resp_len) {
+    uint32_t req_len;
+    uint8_t result;
+    uint8_t adaptive;
+    uint8_t i;
+    unsigned long timeout;
+    unsigned long start;
+    
+    if (_fd < 0) {
+        return FN_ERR_NOT_FOUND;
+    }
+    
+    if (segs == NULL || count == 0 || segs[0].data == NULL ||
+        response == NULL || resp_len == NULL) {
+        return FN_ERR_INVALID;
+    }
+    
+    req_len = 0;
+    for (i = 0; i < count; i++) {
+        if (segs[i].data == NULL && segs[i].len > 0) {
+            return FN_ERR_INVALID;
+        }
+        req_len += segs[i].len;
+    }
+    if (req_len == 0 || (!wire && req_len > _max_frame)) {
+        return FN_ERR_INVALID;
+    }
+    
+    /*
+     * Discard stale input (e.g., a late response to a timed-out request)
+     * before sending, so anything read afterwards belongs to this exchange.
+     */
+    _discard_input();
+    
+    /*
+     * A request the library will send again (or can do without) gets the
+     * adaptive deadline, so a lost frame costs about one round trip rather
+     * than the full timeout. Anything else (a READ on a TCP session, the last attempt)
+     * waits the full timeout: its late response would be discarded with
+     * the next exchange, and with it data the device has already sent.
+     * Only adaptive round trips are sampled: others (e.g. an OPEN that
+     * waits on DNS) measure the device, not the link.
+     */
+    adaptive = fn_exchange_adaptive;
+    timeout = adaptive ? _rto : FN_TRANSPORT_TIMEOUT;
+    start = _now_ms();
+    
+    if (fn_uring_active()) {
+        result = _uring_exchange(segs, count, req_len, wire, response, resp_max, resp_len, timeout);
+    } else {
+        if (wire) {
+            result = _write_all(segs[0].data, req_len);
+        } else {
+            result = _send_segments(segs, count);
+        }
+        if (result == FN_OK) {
+            result = _recv_timed(response, resp_max, resp_len, timeout);
+        }
+    }
+    
+    if (adaptive) {
+        if (result == FN_OK) {
+            _rtt_sample(_now_ms() - start);
+        } else if (result == FN_ERR_TIMEOUT) {
+            _rtt_backoff();
+        }
+    }
+    
+    return result;
+}
+
+/*
+ * Exchange a FujiBus packet with the device.
+ * Sends the request packet and receives the response.
+ * 
+ * request: FujiBus request packet (not SLIP-encoded)
+ * req_len: length of request packet
+ * response: buffer for response packet (SLIP-decoded)
+ * resp_max: maximum response buffer size (also used as receive space)
+ * resp_len: pointer to receive actual response length
+ *
+ * Returns: FN_OK on success, error code on failure
+ */
+uint8_t fn_transport_exchange(const uint8_t *request,
+                               uint16_t req_len,
+                               uint8_t *response,
+                               uint16_t resp_max,
+                               uint16_t *resp_len) {
+    fn_segment_t seg;
+    
+    seg.data = request;
+    seg.len = req_len;
+    return _exchange(&seg, 1, 0, response, resp_max, resp_len);
+}
+
+/*
+ * Exchange a request the library has already SLIP-encoded.
+ */
+uint8_t fn_transport_exchange_wire(const uint8_t *wire,
+                                    uint16_t wire_len,
+                                    uint8_t *response,
+                                    uint16_t resp_max,
+                                    uint16_t *resp_len) {
+    fn_segment_t seg;
+    
+    seg.data = wire;
+    seg.len = wire_len;
+    return _exchange(&seg, 1, 1, response, resp_max, resp_len);
+}
+
+/*
+ * Exchange a request packet given as segments (header, then the caller's
+ * data), encoded as one frame without copying it together first.
+ */
+static uint8_t _exchange_sg(const fn_segment_t *segs,
+                            uint8_t count,
+                            uint8_t *response,
+                            uint16_t resp_max,
+                            uint16_t *resp_len) {
+    return _exchange(segs, count, 0, response, resp_max, resp_len);
+}
+
 /*
  * Close the transport.
  */
 void fn_transport_close(void) {
     if (_fd >= 0) {
         /* Restore original termios settings */
-        tcsetattr(_fd, TCSANOW, &_saved_termios);
+        if (_is_tty) {
+            if (_saved_serial_flags >= 0) {
+                fn_serial_set_flags(_fd, _saved_serial_flags);
+                _saved_serial_flags = -1;
+            }
+            tcsetattr(_fd, TCSANOW, &_saved_termios);
+        }
+        fn_uring_close();
         close(_fd);
         _fd = -1;
     }
+    _free_buffers();
+}
+
+/*
+ * Get the platform name string.
+ */
+const char *fn_platform_name(void) {
+    return "linux";
+}
+
+/* ============================================================================
+ * Transport Operations Tables
+ * ============================================================================ */
+
+static uint8_t _serial_ops_init(void) {
+    if (_fd >= 0) {
+        return FN_OK;
+    }
+    return _init_serial(_get_port());
+}
+
+static uint8_t _socket_ops_init(void) {
+    const char *port;
+    
+    if (_fd >= 0) {
+        return FN_OK;
+    }
+    
+    port = _get_port();
+    if (!_is_socket_port(port)) {
+        fprintf(stderr, "fn_transport: %s is not a unix: or tcp:// socket\n", port);
+        return FN_ERR_INVALID;
+    }
+    return _init_socket(port);
+}
+
+/* Serial links can corrupt bytes, so responses carry checksums we verify */
+const fn_transport_ops_t fn_transport_serial = {
+    "serial",
+    FN_FRAME_SIZE_LIMIT,
+    FN_TRANSPORT_CAP_CHECKSUM | FN_TRANSPORT_CAP_PIPELINE | FN_TRANSPORT_CAP_ASYNC,
+    _serial_ops_init,
+    fn_transport_ready,
+    fn_transport_exchange,
+    fn_transport_close,
+    _send_frame,
+    _recv_frame,
+    _poll_frame,
+    _set_max_frame,
+    fn_transport_exchange_wire,
+    _exchange_sg,
+    _set_buffer,
+    _discard_input
+};
+
+/* Stream sockets are reliable, so checksum verification is skipped */
+const fn_transport_ops_t fn_transport_socket = {
+    "socket",
+    FN_FRAME_SIZE_LIMIT,
+    FN_TRANSPORT_CAP_PIPELINE | FN_TRANSPORT_CAP_ASYNC,
+    _socket_ops_init,
+    fn_transport_ready,
+    fn_transport_exchange,
+    fn_transport_close,
+    _send_frame,
+    _recv_frame,
+    _poll_frame,
+    _set_max_frame,
+    fn_transport_exchange_wire,
+    _exchange_sg,
+    _set_buffer,
+    _discard_input
+};
+
+/*
+ * Pick the transport from the FN_PORT scheme.
+ */
+const fn_transport_ops_t *fn_transport_default(void) {
+    if (_is_socket_port(_get_port())) {
+        return &fn_transport_socket;
+    }
+    return &fn_transport_serial;
 }
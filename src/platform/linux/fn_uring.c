@@ -0,0 +1,348 @@
+/*
+ * fn_uring.c - io_uring backend for the Linux transport
+ *
+ * Talks to the kernel with the raw io_uring syscalls, so there is no
+ * liburing dependency. A request/response exchange costs one
+ * io_uring_enter() where the select() path needs a write(), a select()
+ * and a read(). If the kernel (or a seccomp policy) refuses io_uring,
+ * fn_uring_open() fails and the transport keeps using the select() path.
+ */
+
+#define _GNU_SOURCE  /* For syscall() */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+
+#include "fujinet-nio.h"
+#include "fn_linux.h"
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#define FN_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef FN_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+
+#define RING_ENTRIES    4
+
+/* Registered buffer indexes */
+#define BUF_TX          0
+#define BUF_RX          1
+
+/* user_data tags */
+#define TAG_WRITE       1
+#define TAG_READ        2
+#define TAG_TIMEOUT     3
+
+static int _ring = -1;
+static uint8_t _is_socket;
+
+/* Registered arenas (owned by the transport) */
+static uint8_t *_tx;
+static uint8_t *_rx;
+static uint32_t _rx_size;
+
+/* Submission ring */
+static void *_sq_ptr;
+static size_t _sq_size;
+static unsigned *_sq_tail;
+static unsigned *_sq_mask;
+static unsigned *_sq_array;
+static struct io_uring_sqe *_sqes;
+static size_t _sqes_size;
+
+/* Completion ring */
+static void *_cq_ptr;
+static size_t _cq_size;
+static unsigned *_cq_head;
+static unsigned *_cq_tail;
+static unsigned *_cq_mask;
+static struct io_uring_cqe *_cqes;
+
+/* Queue an SQE; the caller fills it in */
+static struct io_uring_sqe *_get_sqe(unsigned *tail) {
+    struct io_uring_sqe *sqe;
+    unsigned idx;
+    
+    idx = *tail & *_sq_mask;
+    sqe = &_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    _sq_array[idx] = idx;
+    (*tail)++;
+    return sqe;
+}
+
+/* Submit queued SQEs and wait for wait_nr completions */
+static int _enter(unsigned submit, unsigned wait_nr) {
+    int ret;
+    
+    do {
+        ret = (int)syscall(__NR_io_uring_enter, _ring, submit, wait_nr,
+                           IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret >= 0) {
+            submit -= (unsigned)ret;
+        }
+    } while ((ret < 0 && errno == EINTR) || (ret > 0 && submit > 0));
+    
+    return ret < 0 ? -errno : 0;
+}
+
+/* Reap completions, recording the result for each tag */
+static void _reap(int *res_write, int *res_read) {
+    unsigned head;
+    struct io_uring_cqe *cqe;
+    
+    head = *_cq_head;
+    while (head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE)) {
+        cqe = &_cqes[head & *_cq_mask];
+        if (cqe->user_data == TAG_WRITE) {
+            *res_write = cqe->res;
+        } else if (cqe->user_data == TAG_READ) {
+            *res_read = cqe->res;
+        }
+        head++;
+    }
+    __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+}
+
+uint8_t fn_uring_open(int fd, uint8_t is_socket,
+                      uint8_t *tx, uint32_t tx_size,
+                      uint8_t *rx, uint32_t rx_size) {
+    struct io_uring_params p;
+    struct iovec iov[2];
+    unsigned char *sq;
+    unsigned char *cq;
+    
+    if (_ring >= 0) {
+        return FN_OK;
+    }
+    
+    memset(&p, 0, sizeof(p));
+    _ring = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+    if (_ring < 0) {
+        return FN_ERR_UNSUPPORTED;
+    }
+    
+    _sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    _cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (_cq_size > _sq_size) {
+            _sq_size = _cq_size;
+        }
+        _cq_size = _sq_size;
+    }
+    
+    _sq_ptr = mmap(NULL, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   _ring, IORING_OFF_SQ_RING);
+    if (_sq_ptr == MAP_FAILED) {
+        _sq_ptr = NULL;
+        fn_uring_close();
+        return FN_ERR_UNSUPPORTED;
+    }
+    
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        _cq_ptr = _sq_ptr;
+    } else {
+        _cq_ptr = mmap(NULL, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       _ring, IORING_OFF_CQ_RING);
+        if (_cq_ptr == MAP_FAILED) {
+            _cq_ptr = NULL;
+            fn_uring_close();
+            return FN_ERR_UNSUPPORTED;
+        }
+    }
+    
+    _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    _sqes = mmap(NULL, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 _ring, IORING_OFF_SQES);
+    if (_sqes == MAP_FAILED) {
+        _sqes = NULL;
+        fn_uring_close();
+        return FN_ERR_UNSUPPORTED;
+    }
+    
+    sq = _sq_ptr;
+    cq = _cq_ptr;
+    _sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    _sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    _sq_array = (unsigned *)(sq + p.sq_off.array);
+    _cq_head = (unsigned *)(cq + p.cq_off.head);
+    _cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    _cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    _cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    
+    /* Pin the arenas once instead of mapping them on every request */
+    iov[BUF_TX].iov_base = tx;
+    iov[BUF_TX].iov_len = tx_size;
+    iov[BUF_RX].iov_base = rx;
+    iov[BUF_RX].iov_len = rx_size;
+    if (syscall(__NR_io_uring_register, _ring, IORING_REGISTER_BUFFERS, iov, 2) < 0) {
+        fn_uring_close();
+        return FN_ERR_UNSUPPORTED;
+    }
+    
+    /* Register the link too, saving a file lookup per request */
+    if (syscall(__NR_io_uring_register, _ring, IORING_REGISTER_FILES, &fd, 1) < 0) {
+        fn_uring_close();
+        return FN_ERR_UNSUPPORTED;
+    }
+    _is_socket = is_socket;
+    _tx = tx;
+    _rx = rx;
+    _rx_size = rx_size;
+    
+    return FN_OK;
+}
+
+void fn_uring_close(void) {
+    if (_sqes != NULL) {
+        munmap(_sqes, _sqes_size);
+        _sqes = NULL;
+    }
+    if (_cq_ptr != NULL && _cq_ptr != _sq_ptr) {
+        munmap(_cq_ptr, _cq_size);
+    }
+    _cq_ptr = NULL;
+    if (_sq_ptr != NULL) {
+        munmap(_sq_ptr, _sq_size);
+        _sq_ptr = NULL;
+    }
+    if (_ring >= 0) {
+        close(_ring);
+        _ring = -1;
+    }
+}
+
+uint8_t fn_uring_active(void) {
+    return _ring >= 0;
+}
+
+int fn_uring_exchange(uint32_t tx_len, unsigned long timeout_ms) {
+    struct io_uring_sqe *sqe;
+    struct __kernel_timespec ts;
+    unsigned tail;
+    unsigned submit;
+    uint32_t sent;
+    int res_write;
+    int res_read;
+    int ret;
+    
+    if (_ring < 0) {
+        return -EBADF;
+    }
+    
+    ts.tv_sec = (long long)(timeout_ms / 1000);
+    ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+    
+    sent = 0;
+    for (;;) {
+        tail = *_sq_tail;
+        submit = 0;
+        
+        /*
+         * Write whatever is left, linked so the read starts after it.
+         * Sockets use send() with MSG_NOSIGNAL so a dropped peer is an
+         * error rather than SIGPIPE.
+         */
+        if (sent < tx_len) {
+            sqe = _get_sqe(&tail);
+            if (_is_socket) {
+                sqe->opcode = IORING_OP_SEND;
+                sqe->msg_flags = MSG_NOSIGNAL;
+            } else {
+                sqe->opcode = IORING_OP_WRITE_FIXED;
+                sqe->off = (uint64_t)-1;
+                sqe->buf_index = BUF_TX;
+            }
+            sqe->fd = 0;
+            sqe->addr = (unsigned long)(_tx + sent);
+            sqe->len = tx_len - sent;
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+            sqe->user_data = TAG_WRITE;
+            submit++;
+        }
+        
+        sqe = _get_sqe(&tail);
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = 0;
+        sqe->addr = (unsigned long)_rx;
+        sqe->len = _rx_size;
+        sqe->off = (uint64_t)-1;
+        sqe->buf_index = BUF_RX;
+        sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+        sqe->user_data = TAG_READ;
+        submit++;
+        
+        sqe = _get_sqe(&tail);
+        sqe->opcode = IORING_OP_LINK_TIMEOUT;
+        sqe->addr = (unsigned long)&ts;
+        sqe->len = 1;
+        sqe->user_data = TAG_TIMEOUT;
+        submit++;
+        
+        __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+        
+        /* Every SQE in the chain posts a completion, cancelled or not */
+        ret = _enter(submit, submit);
+        if (ret < 0) {
+            return ret;
+        }
+        
+        res_write = 0;
+        res_read = -ECANCELED;
+        _reap(&res_write, &res_read);
+        
+        if (sent < tx_len) {
+            if (res_write < 0) {
+                return res_write;
+            }
+            sent += (uint32_t)res_write;
+            if (sent < tx_len) {
+                /* Short write broke the chain; send the rest first */
+                continue;
+            }
+        }
+        
+        if (res_read == -ECANCELED) {
+            return -ETIME;  /* The linked timeout cancelled the read */
+        }
+        return res_read;
+    }
+}
+
+#else /* !FN_HAVE_IO_URING */
+
+uint8_t fn_uring_open(int fd, uint8_t is_socket,
+                      uint8_t *tx, uint32_t tx_size,
+                      uint8_t *rx, uint32_t rx_size) {
+    (void)fd;
+    (void)is_socket;
+    (void)tx;
+    (void)tx_size;
+    (void)rx;
+    (void)rx_size;
+    return FN_ERR_UNSUPPORTED;
+}
+
+void fn_uring_close(void) {
+}
+
+uint8_t fn_uring_active(void) {
+    return 0;
+}
+
+int fn_uring_exchange(uint32_t tx_len, unsigned long timeout_ms) {
+    (void)tx_len;
+    (void)timeout_ms;
+    return -ENOSYS;
+}
+
+#endif /* FN_HAVE_IO_URING */
@@ -0,0 +1,172 @@
+/*
+ * bench_latency.c - Per-exchange latency over a PTY loopback
+ *
+ * Forks a stand-in device on the master side of a PTY that returns each
+ * SLIP frame it receives, optionally after a fixed delay, and times
+ * fn_transport_exchange() round trips through the Linux serial transport
+ * on the slave side. The exchange cost on top of the device's own delay
+ * is the transport's overhead (fixed sleeps, polling ticks, flushes).
+ *
+ * Usage: bench_latency [iterations [delay_us]]
+ *   With no arguments, runs an instant device and one that answers
+ *   after 3 ms.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+#include "fn_platform.h"
+
+#define MAX_ITERATIONS  100000
+
+static double _lat[MAX_ITERATIONS];
+
+static double _now_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static int _cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Stand-in device: send every complete SLIP frame back, delay_us later */
+static void _responder(int fd, long delay_us) {
+    uint8_t in[4096];
+    uint8_t frame[4096];
+    size_t len = 0;
+    ssize_t n;
+    ssize_t i;
+
+    for (;;) {
+        n = read(fd, in, sizeof(in));
+        if (n <= 0) {
+            _exit(0);
+        }
+        for (i = 0; i < n; i++) {
+            if (len < sizeof(frame)) {
+                frame[len++] = in[i];
+            }
+            if (in[i] == SLIP_END && len > 1) {
+                if (delay_us > 0) {
+                    usleep(delay_us);
+                }
+                if (write(fd, frame, len) != (ssize_t)len) {
+                    _exit(1);
+                }
+                len = 0;
+            }
+        }
+    }
+}
+
+static int _run(int iterations, long delay_us) {
+    uint8_t req[16];
+    uint8_t resp[1024];
+    uint16_t resp_len;
+    struct termios t;
+    char name[128];
+    double start;
+    double total;
+    pid_t pid;
+    int master;
+    int slave;
+    int status;
+    int i;
+
+    if (openpty(&master, &slave, name, NULL, NULL) != 0) {
+        perror("openpty");
+        return 1;
+    }
+    tcgetattr(slave, &t);
+    cfmakeraw(&t);
+    tcsetattr(slave, TCSANOW, &t);
+    tcgetattr(master, &t);
+    cfmakeraw(&t);
+    tcsetattr(master, TCSANOW, &t);
+
+    pid = fork();
+    if (pid == 0) {
+        close(slave);
+        _responder(master, delay_us);
+    }
+    close(master);
+    setenv("FN_PORT", name, 1);
+
+    if (fn_transport_init() != FN_OK) {
+        printf("transport init failed on %s\n", name);
+        kill(pid, SIGKILL);
+        return 1;
+    }
+
+    /* An INFO-sized packet: the device sends it straight back */
+    memset(req, 0x5A, sizeof(req));
+    req[0] = FN_DEVICE_NETWORK;
+    req[1] = FN_CMD_INFO;
+    req[2] = sizeof(req);
+    req[3] = 0;
+    req[4] = 0;
+    req[5] = 0;
+
+    total = 0;
+    for (i = 0; i < iterations; i++) {
+        start = _now_us();
+        if (fn_transport_exchange(req, sizeof(req), resp, sizeof(resp), &resp_len) != FN_OK ||
+            resp_len != sizeof(req) || memcmp(req, resp, sizeof(req)) != 0) {
+            printf("exchange %d failed\n", i);
+            kill(pid, SIGKILL);
+            return 1;
+        }
+        _lat[i] = _now_us() - start;
+        total += _lat[i];
+    }
+
+    qsort(_lat, iterations, sizeof(double), _cmp_double);
+    printf("device delay %5ld us: %6d exchanges, mean %8.1f us, p50 %8.1f us, p99 %8.1f us, "
+           "overhead %7.1f us, %7.0f exchanges/s\n",
+           delay_us, iterations, total / iterations, _lat[iterations / 2],
+           _lat[iterations * 99 / 100], total / iterations - delay_us,
+           iterations * 1e6 / total);
+    fflush(stdout);
+
+    close(slave);
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int iterations;
+    int status;
+
+    if (argc > 1) {
+        iterations = atoi(argv[1]);
+        if (iterations < 1 || iterations > MAX_ITERATIONS) {
+            printf("iterations must be 1..%d\n", MAX_ITERATIONS);
+            return 1;
+        }
+        return _run(iterations, argc > 2 ? atol(argv[2]) : 0);
+    }
+
+    /* Each run is a separate process: the transport keeps one port open */
+    if (fork() == 0) {
+        _exit(_run(5000, 0));
+    }
+    if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return 1;
+    }
+    return _run(300, 3000);
+}
@@ -0,0 +1,90 @@
+/*
+ * bench_parse.c - Response header parse cost by packet size
+ *
+ * Times fn_parse_response_header() on valid response packets of 16 bytes,
+ * 512 bytes and 1 KiB. The serial transport is selected, so the parse
+ * verifies the checksum over the whole packet, as it does for responses
+ * read from a serial link.
+ *
+ * Usage: bench_parse [total_bytes]
+ *   Each size is parsed until about total_bytes (default 200000000) have
+ *   been covered.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+#include "fn_platform.h"
+#include "fn_internal.h"
+
+static const uint16_t _sizes[] = { 16, 512, 1024 };
+
+static uint8_t _pkt[1024];
+
+static double _now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    volatile uint16_t sink = 0;
+    uint16_t data_offset;
+    uint16_t data_len;
+    uint16_t n;
+    uint8_t status;
+    double total;
+    double start;
+    double elapsed;
+    long iterations;
+    long i;
+    size_t s;
+
+    total = argc > 1 ? atof(argv[1]) : 200e6;
+
+    if (fn_transport_register(&fn_transport_serial) != FN_OK) {
+        printf("cannot select the serial transport\n");
+        return 1;
+    }
+
+    for (s = 0; s < sizeof(_sizes) / sizeof(_sizes[0]); s++) {
+        n = _sizes[s];
+
+        /* A simple response: header, then payload */
+        for (i = 0; i < n; i++) {
+            _pkt[i] = (uint8_t)(i * 37 + 11);
+        }
+        _pkt[0] = FN_DEVICE_NETWORK;
+        _pkt[1] = FN_CMD_READ;
+        _pkt[2] = n & 0xFF;
+        _pkt[3] = n >> 8;
+        _pkt[4] = 0;
+        _pkt[5] = 0;
+        _pkt[4] = fn_calc_checksum(_pkt, n);
+
+        iterations = (long)(total / n);
+        if (iterations < 1) {
+            iterations = 1;
+        }
+
+        start = _now_ns();
+        for (i = 0; i < iterations; i++) {
+            if (fn_parse_response_header(_pkt, n, &status, &data_offset, &data_len) != FN_OK) {
+                printf("%u B: parse failed\n", n);
+                return 1;
+            }
+            sink += data_len;
+        }
+        elapsed = _now_ns() - start;
+
+        printf("%5u B: %8.1f ns/parse, %5.2f ns/byte\n",
+               n, elapsed / iterations, elapsed / iterations / n);
+    }
+
+    (void)sink;
+    return 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * bench_pipeline.c - fn_read_pipelined() throughput by pipeline depth
+ *
+ * Forks a stand-in device on the master side of a PTY that answers the
+ * frame size negotiation, OPEN, READ and CLOSE. Every response leaves the
+ * device one link round trip after its request arrived, without holding
+ * back the requests behind it, the way a slow link with a fast device
+ * behaves. The benchmark then reads the device's whole content with one
+ * fn_read_pipelined() call per depth and checks every byte.
+ *
+ * Usage: bench_pipeline [latency_us [frame_size]]
+ *   latency_us is the one-way link latency (default 2000). With no
+ *   frame size, runs with 4 KiB frames and with 64 KiB frames.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+
+#define CONTENT_SIZE    (512UL * 1024)
+#define MAX_PENDING     64
+
+static const uint8_t _depths[] = { 1, 2, 4, 8 };
+
+static uint8_t _buf[CONTENT_SIZE];
+
+typedef struct {
+    double due;
+    size_t len;
+    uint8_t *data;
+} pending_t;
+
+static double _now_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static uint8_t _content(uint32_t i) {
+    return (uint8_t)(i * 7 + (i >> 12));
+}
+
+static uint16_t _get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t _get32(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void _put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void _put32(uint8_t *p, uint32_t v) {
+    _put16(p, v & 0xFFFF);
+    _put16(p + 2, v >> 16);
+}
+
+/* Build the response to one request, SLIP-framed, into a new buffer */
+static uint8_t *_respond(const uint8_t *req, size_t req_len, uint16_t max_frame, size_t *out_len) {
+    static uint8_t pkt[FN_FRAME_SIZE_LIMIT];
+    const uint8_t *p;
+    uint8_t *out;
+    uint32_t off;
+    uint16_t want;
+    uint16_t n;
+    size_t len;
+    size_t i;
+    size_t o;
+
+    p = req + FN_HEADER_SIZE;
+    memset(pkt, 0, FN_HEADER_SIZE + 16);
+    pkt[0] = req[0];
+    pkt[1] = req[1];
+    pkt[6] = 1;
+    len = FN_HEADER_SIZE + 4;
+
+    if (req_len < FN_HEADER_SIZE) {
+        pkt[5] = 1;
+        pkt[6] = FN_ERR_INVALID;
+        len = FN_HEADER_SIZE + 1;
+    } else if (req[0] == FN_DEVICE_FUJI && req[1] == FN_CMD_FUJI_FRAME_SIZE) {
+        want = _get16(p + 1);
+        _put16(pkt + 10, want < max_frame ? want : max_frame);
+        len += 2;
+    } else if (req[0] == FN_DEVICE_NETWORK && req[1] == FN_CMD_OPEN) {
+        pkt[7] = FN_OPEN_RESP_ACCEPTED;
+        _put16(pkt + 10, 1);
+        pkt[12] = 0;            /* Random access, like HTTP */
+        len += 3;
+    } else if (req[0] == FN_DEVICE_NETWORK && req[1] == FN_CMD_READ) {
+        off = _get32(p + 3);
+        want = _get16(p + 7);
+        n = 0;
+        if (off < CONTENT_SIZE) {
+            n = (CONTENT_SIZE - off < want) ? (uint16_t)(CONTENT_SIZE - off) : want;
+        }
+        if (off + n >= CONTENT_SIZE) {
+            pkt[7] = FN_READ_RESP_EOF;
+        }
+        memcpy(pkt + 10, p + 1, 2);
+        _put32(pkt + 12, off);
+        _put16(pkt + 16, n);
+        for (i = 0; i < n; i++) {
+            pkt[18 + i] = _content(off + i);
+        }
+        len = 18 + n;
+    } else if (req[0] != FN_DEVICE_NETWORK || req[1] != FN_CMD_CLOSE) {
+        pkt[5] = 1;
+        pkt[6] = FN_ERR_UNSUPPORTED;
+        len = FN_HEADER_SIZE + 1;
+    }
+
+    _put16(pkt + 2, (uint16_t)len);
+    pkt[4] = fn_calc_checksum(pkt, (uint16_t)len);
+
+    out = malloc(len * 2 + 2);
+    o = 0;
+    out[o++] = SLIP_END;
+    for (i = 0; i < len; i++) {
+        if (pkt[i] == SLIP_END) {
+            out[o++] = SLIP_ESCAPE;
+            out[o++] = SLIP_ESC_END;
+        } else if (pkt[i] == SLIP_ESCAPE) {
+            out[o++] = SLIP_ESCAPE;
+            out[o++] = SLIP_ESC_ESC;
+        } else {
+            out[o++] = pkt[i];
+        }
+    }
+    out[o++] = SLIP_END;
+    *out_len = o;
+    return out;
+}
+
+/* Stand-in device: answer each request 2 * latency_us after it arrives */
+static void _device(int fd, long latency_us, uint16_t max_frame) {
+    static uint8_t frame[FN_FRAME_SIZE_LIMIT];
+    pending_t queue[MAX_PENDING];
+    uint8_t in[4096];
+    struct pollfd pfd;
+    size_t len = 0;
+    size_t w;
+    int head = 0;
+    int count = 0;
+    int in_frame = 0;
+    int esc = 0;
+    int timeout;
+    double wait_us;
+    ssize_t n;
+    ssize_t i;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    for (;;) {
+        timeout = -1;
+        if (count > 0) {
+            wait_us = queue[head].due - _now_us();
+            timeout = wait_us > 0 ? (int)(wait_us / 1000) : 0;
+        }
+        if (count < MAX_PENDING && poll(&pfd, 1, timeout) > 0) {
+            n = read(fd, in, sizeof(in));
+            if (n <= 0) {
+                _exit(0);
+            }
+            for (i = 0; i < n; i++) {
+                if (in[i] == SLIP_END) {
+                    if (in_frame && len > 0 && count < MAX_PENDING) {
+                        pending_t *pe = &queue[(head + count) % MAX_PENDING];
+                        pe->due = _now_us() + 2.0 * latency_us;
+                        pe->data = _respond(frame, len, max_frame, &pe->len);
+                        count++;
+                    }
+                    in_frame = 1;
+                    esc = 0;
+                    len = 0;
+                } else if (!in_frame) {
+                    continue;
+                } else if (esc) {
+                    frame[len++] = (in[i] == SLIP_ESC_END) ? SLIP_END : SLIP_ESCAPE;
+                    esc = 0;
+                } else if (in[i] == SLIP_ESCAPE) {
+                    esc = 1;
+                } else if (len < sizeof(frame)) {
+                    frame[len++] = in[i];
+                }
+            }
+        }
+
+        /* Sub-millisecond remainders: spin until due */
+        while (count > 0 && queue[head].due <= _now_us()) {
+            for (w = 0; w < queue[head].len; ) {
+                n = write(fd, queue[head].data + w, queue[head].len - w);
+                if (n <= 0) {
+                    _exit(1);
+                }
+                w += n;
+            }
+            free(queue[head].data);
+            head = (head + 1) % MAX_PENDING;
+            count--;
+        }
+    }
+}
+
+static int _run(long latency_us, uint16_t max_frame) {
+    struct termios t;
+    char name[128];
+    fn_handle_t handle;
+    uint32_t bytes_read;
+    uint32_t i;
+    uint8_t flags;
+    uint8_t result;
+    double start;
+    double elapsed;
+    pid_t pid;
+    int master;
+    int slave;
+    int status;
+    size_t d;
+
+    if (openpty(&master, &slave, name, NULL, NULL) != 0) {
+        perror("openpty");
+        return 1;
+    }
+    tcgetattr(master, &t);
+    cfmakeraw(&t);
+    tcsetattr(master, TCSANOW, &t);
+
+    pid = fork();
+    if (pid == 0) {
+        close(slave);
+        _device(master, latency_us, max_frame);
+    }
+    close(master);
+    setenv("FN_PORT", name, 1);
+
+    result = fn_init();
+    if (result != FN_OK) {
+        printf("fn_init: %s\n", fn_error_string(result));
+        kill(pid, SIGKILL);
+        return 1;
+    }
+
+    for (d = 0; d < sizeof(_depths); d++) {
+        result = fn_open(&handle, FN_METHOD_GET, "http://bench/content", 0);
+        if (result != FN_OK) {
+            printf("fn_open: %s\n", fn_error_string(result));
+            kill(pid, SIGKILL);
+            return 1;
+        }
+
+        memset(_buf, 0, sizeof(_buf));
+        start = _now_us();
+        result = fn_read_pipelined(handle, 0, _buf, CONTENT_SIZE, _depths[d], &bytes_read, &flags);
+        elapsed = _now_us() - start;
+        fn_close(handle);
+
+        if (result != FN_OK || bytes_read != CONTENT_SIZE || !(flags & FN_READ_EOF)) {
+            printf("depth %u: %s after %lu bytes\n", _depths[d], fn_error_string(result),
+                   (unsigned long)bytes_read);
+            kill(pid, SIGKILL);
+            return 1;
+        }
+        for (i = 0; i < CONTENT_SIZE; i++) {
+            if (_buf[i] != _content(i)) {
+                printf("depth %u: wrong data at offset %lu\n", _depths[d], (unsigned long)i);
+                kill(pid, SIGKILL);
+                return 1;
+            }
+        }
+
+        printf("latency %5ld us, frame %5u: depth %u, %lu bytes in %7.1f ms, %7.0f KB/s\n",
+               latency_us, max_frame, _depths[d], (unsigned long)bytes_read,
+               elapsed / 1000, bytes_read / 1024.0 / (elapsed / 1e6));
+        fflush(stdout);
+    }
+
+    close(slave);
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    long latency_us;
+    int status;
+
+    latency_us = argc > 1 ? atol(argv[1]) : 2000;
+    if (argc > 2) {
+        return _run(latency_us, (uint16_t)atoi(argv[2]));
+    }
+
+    /* Each run is a separate process: the frame size is agreed at fn_init() */
+    if (fork() == 0) {
+        _exit(_run(latency_us, 4096));
+    }
+    if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return 1;
+    }
+    return _run(latency_us, FN_FRAME_SIZE_LIMIT);
+}
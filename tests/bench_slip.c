@@ -0,0 +1,187 @@
+/*
+ * bench_slip.c - SLIP throughput by special-byte density
+ *
+ * Encodes and decodes 32000-byte payloads in which a given share of the
+ * bytes are END or ESCAPE, through fn_slip_encode(), the incremental
+ * decoder and fn_slip_decode(), and checks each round trip.
+ *
+ * It also times fn_slip_scan() on short clean runs (the length of a
+ * typical run between special bytes) against a plain byte loop over the
+ * same bytes. A vector scan slower than the byte loop means something
+ * costs far more than the scan itself, such as the stall when legacy SSE
+ * code runs with the upper AVX state dirty; the benchmark then fails.
+ *
+ * Usage: bench_slip [iterations]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+#include "fn_internal.h"
+
+#define PAYLOAD     32000
+#define SCAN_CALLS  2000000
+
+static const double _densities[] = { 0.0, 0.001, 0.01, 0.1, 0.5 };
+static const uint16_t _scan_lens[] = { 16, 64, 100, 256 };
+
+static uint8_t _in[PAYLOAD];
+static uint8_t _enc[2 * PAYLOAD + 2];
+static uint8_t _out[PAYLOAD + 8];
+
+static double _now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/* The reference: length of the run before the next END or ESCAPE */
+static uint16_t _scan_bytes(const uint8_t *data, uint16_t len) {
+    uint16_t i;
+
+    for (i = 0; i < len; i++) {
+        if (data[i] == SLIP_END || data[i] == SLIP_ESCAPE) {
+            break;
+        }
+    }
+    return i;
+}
+
+static int _throughput(double density, long iterations) {
+    fn_slip_decoder_t dec;
+    uint16_t enc_len;
+    uint16_t used;
+    double encode;
+    double feed;
+    double decode;
+    double start;
+    long it;
+    long i;
+
+    srand(1);
+    for (i = 0; i < PAYLOAD; i++) {
+        _in[i] = (uint8_t)rand();
+        if (_in[i] == SLIP_END || _in[i] == SLIP_ESCAPE) {
+            _in[i] = 1;
+        }
+        if ((double)rand() / RAND_MAX < density) {
+            _in[i] = (rand() & 1) ? SLIP_END : SLIP_ESCAPE;
+        }
+    }
+
+    start = _now_ns();
+    for (it = 0; it < iterations; it++) {
+        enc_len = fn_slip_encode(_in, PAYLOAD, _enc);
+    }
+    encode = _now_ns() - start;
+
+    start = _now_ns();
+    for (it = 0; it < iterations; it++) {
+        fn_slip_decoder_init(&dec, _out, sizeof(_out));
+        if (fn_slip_decoder_feed(&dec, _enc, enc_len, &used) != FN_SLIP_FRAME || dec.len != PAYLOAD) {
+            printf("density %.1f%%: decoder failed\n", density * 100);
+            return 1;
+        }
+    }
+    feed = _now_ns() - start;
+    if (memcmp(_out, _in, PAYLOAD) != 0) {
+        printf("density %.1f%%: decoder output differs\n", density * 100);
+        return 1;
+    }
+
+    memset(_out, 0, sizeof(_out));
+    start = _now_ns();
+    for (it = 0; it < iterations; it++) {
+        if (fn_slip_decode(_enc, enc_len, _out) != PAYLOAD) {
+            printf("density %.1f%%: decode failed\n", density * 100);
+            return 1;
+        }
+    }
+    decode = _now_ns() - start;
+    if (memcmp(_out, _in, PAYLOAD) != 0) {
+        printf("density %.1f%%: decode output differs\n", density * 100);
+        return 1;
+    }
+
+    printf("density %5.1f%%: encode %6.0f MB/s, feed %6.0f MB/s, decode %6.0f MB/s\n",
+           density * 100,
+           (double)PAYLOAD * iterations / encode * 1e3,
+           (double)PAYLOAD * iterations / feed * 1e3,
+           (double)PAYLOAD * iterations / decode * 1e3);
+    return 0;
+}
+
+static int _short_scans(void) {
+    volatile uint16_t sink = 0;
+    uint16_t len;
+    double scan;
+    double bytes;
+    double start;
+    long i;
+    size_t s;
+    int slow = 0;
+
+    /* Clean data, ending in an END just past the run */
+    for (i = 0; i < PAYLOAD; i++) {
+        _in[i] = (uint8_t)(i * 7 + 1);
+        if (_in[i] == SLIP_END || _in[i] == SLIP_ESCAPE) {
+            _in[i] = 1;
+        }
+    }
+
+    for (s = 0; s < sizeof(_scan_lens) / sizeof(_scan_lens[0]); s++) {
+        len = _scan_lens[s];
+        _in[len] = SLIP_END;
+
+        if (fn_slip_scan(_in, len + 1) != len || fn_slip_scan(_in, len) != len) {
+            printf("scan %3u B: wrong length\n", len);
+            return 1;
+        }
+
+        start = _now_ns();
+        for (i = 0; i < SCAN_CALLS; i++) {
+            sink += fn_slip_scan(_in + (i & 1), len);
+        }
+        scan = (_now_ns() - start) / SCAN_CALLS;
+
+        start = _now_ns();
+        for (i = 0; i < SCAN_CALLS; i++) {
+            sink += _scan_bytes(_in + (i & 1), len);
+        }
+        bytes = (_now_ns() - start) / SCAN_CALLS;
+
+        /* Below 64 bytes the call and dispatch can outweigh the scan */
+        printf("scan %3u B: fn_slip_scan %6.1f ns, byte loop %6.1f ns%s\n",
+               len, scan, bytes, (scan > bytes && len >= 64) ? "  <- slower than the byte loop" : "");
+        if (scan > bytes && len >= 64) {
+            slow = 1;
+        }
+        _in[len] = 1;
+    }
+
+    (void)sink;
+    return slow;
+}
+
+int main(int argc, char **argv) {
+    long iterations;
+    size_t d;
+
+    iterations = argc > 1 ? atol(argv[1]) : 5000;
+    if (iterations < 1) {
+        printf("iterations must be at least 1\n");
+        return 1;
+    }
+
+    for (d = 0; d < sizeof(_densities) / sizeof(_densities[0]); d++) {
+        if (_throughput(_densities[d], iterations) != 0) {
+            return 1;
+        }
+    }
+    return _short_scans();
+}
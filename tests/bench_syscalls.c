@@ -0,0 +1,254 @@
+/*
+ * bench_syscalls.c - System calls and latency per exchange
+ *
+ * Forks a stand-in device that returns each request unchanged, on a PTY
+ * and on a unix socket, and runs fn_transport_exchange() round trips
+ * through the Linux transport with the select() path and with the
+ * io_uring backend (FN_IO_URING=1). For each it reports the system calls
+ * one exchange makes, counted with ptrace, and the untraced latency.
+ *
+ * Usage: bench_syscalls [iterations]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <linux/ptrace.h>
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+#include "fn_platform.h"
+
+/* Brackets the measured loop in the traced child */
+#define MARKER_SYSCALL  SYS_getppid
+
+/* Held open for the run, so the PTY stays there between clients */
+static int _pty_slave = -1;
+
+static double _now_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+/* Stand-in device: send every byte straight back */
+static void _echo(int fd) {
+    uint8_t buf[4096];
+    ssize_t n;
+
+    for (;;) {
+        n = read(fd, buf, sizeof(buf));
+        if (n <= 0 || write(fd, buf, n) != n) {
+            _exit(0);
+        }
+    }
+}
+
+static pid_t _serve_pty(char *port, size_t size) {
+    struct termios t;
+    char name[128];
+    pid_t pid;
+    int master;
+    int slave;
+
+    if (openpty(&master, &slave, name, NULL, NULL) != 0) {
+        return -1;
+    }
+    tcgetattr(master, &t);
+    cfmakeraw(&t);
+    tcsetattr(master, TCSANOW, &t);
+
+    pid = fork();
+    if (pid == 0) {
+        close(slave);
+        _echo(master);
+    }
+    close(master);
+    _pty_slave = slave;
+    snprintf(port, size, "%s", name);
+    return pid;
+}
+
+static pid_t _serve_socket(char *port, size_t size) {
+    struct sockaddr_un addr;
+    pid_t pid;
+    int listener;
+    int conn;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/fn_bench_%d.sock", (int)getpid());
+    unlink(addr.sun_path);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener, 4) != 0) {
+        return -1;
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        for (;;) {
+            conn = accept(listener, NULL, NULL);
+            if (conn >= 0 && fork() == 0) {
+                _echo(conn);
+            }
+            close(conn);
+        }
+    }
+    close(listener);
+    snprintf(port, size, "unix:%s", addr.sun_path);
+    return pid;
+}
+
+/* Child side: open the link, then run the exchanges */
+static void _client(int iterations, int traced) {
+    uint8_t req[16];
+    uint8_t resp[1024];
+    uint16_t resp_len;
+    double start;
+    int i;
+
+    memset(req, 0x5A, sizeof(req));
+    req[0] = FN_DEVICE_NETWORK;
+    req[1] = FN_CMD_INFO;
+    req[2] = sizeof(req);
+    req[3] = 0;
+
+    if (fn_transport_init() != FN_OK) {
+        _exit(1);
+    }
+    if (traced) {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        syscall(MARKER_SYSCALL);
+    }
+
+    start = _now_us();
+    for (i = 0; i < iterations; i++) {
+        if (fn_transport_exchange(req, sizeof(req), resp, sizeof(resp), &resp_len) != FN_OK ||
+            resp_len != sizeof(req) || memcmp(req, resp, sizeof(req)) != 0) {
+            printf("exchange %d failed\n", i);
+            _exit(1);
+        }
+    }
+
+    if (traced) {
+        syscall(MARKER_SYSCALL);
+    } else {
+        printf("%.1f us/exchange\n", (_now_us() - start) / iterations);
+    }
+    fflush(stdout);
+    _exit(0);
+}
+
+/* Count the system calls the child makes between its two markers */
+static long _count_syscalls(pid_t pid) {
+    struct ptrace_syscall_info info;
+    long count = 0;
+    int counting = 0;
+    int status;
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) {
+        return -1;
+    }
+    ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD);
+    ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+
+    while (waitpid(pid, &status, 0) > 0 && !WIFEXITED(status) && !WIFSIGNALED(status)) {
+        if (WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80) &&
+            ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) > 0 &&
+            info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+            if (info.entry.nr == MARKER_SYSCALL) {
+                counting = !counting;
+            } else if (counting) {
+                count++;
+            }
+        }
+        ptrace(PTRACE_SYSCALL, pid, NULL, NULL);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return count;
+}
+
+static int _run(const char *link, int uring, int iterations) {
+    char port[128];
+    pid_t server;
+    pid_t pid;
+    long count;
+    int status;
+
+    server = (strcmp(link, "pty") == 0) ? _serve_pty(port, sizeof(port))
+                                        : _serve_socket(port, sizeof(port));
+    if (server < 0) {
+        printf("%s: no stand-in device\n", link);
+        return 1;
+    }
+    setenv("FN_PORT", port, 1);
+    if (uring) {
+        setenv("FN_IO_URING", "1", 1);
+    } else {
+        unsetenv("FN_IO_URING");
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        _client(iterations, 1);
+    }
+    count = _count_syscalls(pid);
+
+    printf("%-6s %-8s: ", link, uring ? "io_uring" : "select");
+    if (count < 0) {
+        printf("traced run failed\n");
+    } else {
+        printf("%5.2f syscalls/exchange, ", (double)count / iterations);
+    }
+    fflush(stdout);
+
+    pid = fork();
+    if (pid == 0) {
+        _client(iterations, 0);
+    }
+    waitpid(pid, &status, 0);
+
+    kill(server, SIGKILL);
+    waitpid(server, &status, 0);
+    if (_pty_slave >= 0) {
+        close(_pty_slave);
+        _pty_slave = -1;
+    }
+    if (strncmp(port, "unix:", 5) == 0) {
+        unlink(port + 5);
+    }
+    return count < 0;
+}
+
+int main(int argc, char **argv) {
+    int iterations;
+    int failed = 0;
+
+    iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    if (iterations < 1) {
+        printf("iterations must be at least 1\n");
+        return 1;
+    }
+
+    failed |= _run("pty", 0, iterations);
+    failed |= _run("pty", 1, iterations);
+    failed |= _run("socket", 0, iterations);
+    failed |= _run("socket", 1, iterations);
+    return failed;
+}
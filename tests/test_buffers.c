@@ -0,0 +1,428 @@
+/*
+ * test_buffers.c - Buffered writes against asynchronous operations
+ *
+ * Forks a stand-in device on the master side of a PTY that answers OPEN,
+ * WRITE, POLL and CLOSE at once and READ after 20 ms, fails every WRITE
+ * to a URL with "fail" in it, and records what each session had written,
+ * and at which offsets, in memory shared with the test. Then checks
+ * that:
+ *   - fn_submit() sends a session's buffered writes before queueing a
+ *     WRITE behind them, so the device sees the bytes in order;
+ *   - fn_submit() returns FN_ERR_BUSY, keeping the buffer, while another
+ *     operation holds the link, and queues the WRITE once it is free;
+ *   - a delayed flush that meets a busy link is tried again later, not
+ *     given up on;
+ *   - fn_poll() reports a session whose buffered writes fail with that
+ *     error, and the others as usual.
+ *
+ * Usage: test_buffers
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "fujinet-nio.h"
+#include "fn_protocol.h"
+
+#define MAX_HANDLES     8
+#define MAX_WRITTEN     256
+#define READ_DELAY_US   20000
+
+/* What the device has been sent, shared with the test process */
+typedef struct {
+    uint32_t writes;
+    uint32_t bad_offsets;
+    uint16_t len[MAX_HANDLES];
+    uint8_t data[MAX_HANDLES][MAX_WRITTEN];
+} device_log_t;
+
+static device_log_t *_log;
+
+static uint16_t _get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t _get32(const uint8_t *p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void _put16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void _put32(uint8_t *p, uint32_t v) {
+    _put16(p, v & 0xFFFF);
+    _put16(p + 2, v >> 16);
+}
+
+/* Build the response to one request into pkt; returns its length */
+static uint16_t _respond(const uint8_t *req, size_t req_len, uint8_t *pkt) {
+    static uint16_t next_handle = 1;
+    static uint8_t failing[MAX_HANDLES];
+    const uint8_t *p;
+    uint16_t handle;
+    uint32_t off;
+    uint16_t n;
+    uint16_t len;
+    uint16_t i;
+
+    p = req + FN_HEADER_SIZE;
+    memset(pkt, 0, FN_HEADER_SIZE + 12);
+    pkt[0] = req[0];
+    pkt[1] = req[1];
+    pkt[6] = 1;
+    len = FN_HEADER_SIZE + 4;
+
+    if (req[0] != FN_DEVICE_NETWORK || (req[1] != FN_CMD_OPEN && req[1] != FN_CMD_CLOSE &&
+                                         req[1] != FN_CMD_READ && req[1] != FN_CMD_WRITE &&
+                                         req[1] != FN_CMD_POLL)) {
+        pkt[5] = 1;
+        pkt[6] = FN_ERR_UNSUPPORTED;
+        len = FN_HEADER_SIZE + 1;
+    } else if ((req[1] == FN_CMD_READ || req[1] == FN_CMD_WRITE) && req_len < FN_HEADER_SIZE + 9) {
+        pkt[5] = 1;
+        pkt[6] = FN_ERR_INVALID;
+        len = FN_HEADER_SIZE + 1;
+    } else if (req[1] == FN_CMD_WRITE && failing[_get16(p + 1) % MAX_HANDLES]) {
+        pkt[5] = 1;
+        pkt[6] = FN_ERR_NOT_READY;
+        len = FN_HEADER_SIZE + 1;
+    } else if (req[1] == FN_CMD_OPEN) {
+        failing[next_handle] = memmem(req, req_len, "fail", 4) != NULL;
+        pkt[7] = FN_OPEN_RESP_ACCEPTED;
+        _put16(pkt + 10, next_handle);
+        next_handle = next_handle % (MAX_HANDLES - 1) + 1;
+        pkt[12] = 0;            /* Random access, like HTTP */
+        len += 3;
+    } else if (req[1] == FN_CMD_READ) {
+        off = _get32(p + 3);
+        n = _get16(p + 7);
+        if (n > 64) {
+            n = 64;
+        }
+        memcpy(pkt + 10, p + 1, 2);
+        _put32(pkt + 12, off);
+        _put16(pkt + 16, n);
+        for (i = 0; i < n; i++) {
+            pkt[18 + i] = (uint8_t)(off + i);
+        }
+        len = 18 + n;
+    } else if (req[1] == FN_CMD_WRITE) {
+        handle = _get16(p + 1) % MAX_HANDLES;
+        off = _get32(p + 3);
+        n = _get16(p + 7);
+        if (off != _log->len[handle] || off + n > MAX_WRITTEN) {
+            _log->bad_offsets++;
+        } else {
+            memcpy(_log->data[handle] + off, p + 9, n);
+            _log->len[handle] = (uint16_t)(off + n);
+        }
+        _log->writes++;
+        memcpy(pkt + 10, p + 1, 2);
+        _put32(pkt + 12, off);
+        _put16(pkt + 16, n);
+        len = 18;
+    } else if (req[1] == FN_CMD_POLL) {
+        /* Every session connected, with nothing to read */
+        n = p[1];
+        pkt[10] = (uint8_t)n;
+        len = 11;
+        for (i = 0; i < n; i++) {
+            memcpy(pkt + len, p + 2 + 2 * i, 2);
+            pkt[len + 2] = FN_INFO_CONNECTED;
+            _put16(pkt + len + 3, 0);
+            len += FN_POLL_ENTRY_SIZE;
+        }
+    }
+
+    _put16(pkt + 2, len);
+    pkt[4] = fn_calc_checksum(pkt, len);
+    return len;
+}
+
+/* Stand-in device: answer each request as soon as it arrives */
+static void _device(int fd) {
+    static uint8_t frame[FN_FRAME_SIZE_LIMIT];
+    static uint8_t pkt[FN_FRAME_SIZE_LIMIT];
+    static uint8_t out[2 * FN_FRAME_SIZE_LIMIT + 2];
+    uint8_t in[4096];
+    size_t len = 0;
+    size_t o;
+    uint16_t n;
+    uint16_t i;
+    int in_frame = 0;
+    int esc = 0;
+    ssize_t got;
+    ssize_t k;
+
+    for (;;) {
+        got = read(fd, in, sizeof(in));
+        if (got <= 0) {
+            _exit(0);
+        }
+        for (k = 0; k < got; k++) {
+            if (in[k] == SLIP_END) {
+                if (in_frame && len > 0) {
+                    /* READs take a while, so the test can catch the link busy */
+                    if (frame[1] == FN_CMD_READ) {
+                        usleep(READ_DELAY_US);
+                    }
+                    n = _respond(frame, len, pkt);
+                    o = 0;
+                    out[o++] = SLIP_END;
+                    for (i = 0; i < n; i++) {
+                        if (pkt[i] == SLIP_END) {
+                            out[o++] = SLIP_ESCAPE;
+                            out[o++] = SLIP_ESC_END;
+                        } else if (pkt[i] == SLIP_ESCAPE) {
+                            out[o++] = SLIP_ESCAPE;
+                            out[o++] = SLIP_ESC_ESC;
+                        } else {
+                            out[o++] = pkt[i];
+                        }
+                    }
+                    out[o++] = SLIP_END;
+                    if (write(fd, out, o) != (ssize_t)o) {
+                        _exit(1);
+                    }
+                }
+                in_frame = 1;
+                esc = 0;
+                len = 0;
+            } else if (!in_frame) {
+                continue;
+            } else if (esc) {
+                frame[len++] = (in[k] == SLIP_ESC_END) ? SLIP_END : SLIP_ESCAPE;
+                esc = 0;
+            } else if (in[k] == SLIP_ESCAPE) {
+                esc = 1;
+            } else if (len < sizeof(frame)) {
+                frame[len++] = in[k];
+            }
+        }
+    }
+}
+
+static int _failures = 0;
+
+static void _check(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        _failures++;
+    }
+}
+
+/* Wait for the one operation in flight and return its completion */
+static fn_completion_t _wait(void) {
+    fn_completion_t c;
+
+    while (fn_poll_completions(&c, 1) == 0) {
+    }
+    return c;
+}
+
+static void _request(fn_request_t *req, uint8_t op, fn_handle_t handle, uint32_t offset,
+                     uint8_t *buf, uint16_t len) {
+    memset(req, 0, sizeof(*req));
+    req->op = op;
+    req->handle = handle;
+    req->offset = offset;
+    req->buf = buf;
+    req->len = len;
+}
+
+/* A WRITE submitted behind buffered writes lands after them */
+static void _test_submit_flushes(void) {
+    static uint8_t tail[] = "world";
+    fn_request_t req;
+    fn_completion_t c;
+    fn_handle_t handle;
+    uint16_t written;
+    uint32_t writes;
+
+    fn_open(&handle, FN_METHOD_PUT, "http://test/submit", FN_OPEN_WRITE_BUFFER);
+    writes = _log->writes;
+
+    _check(fn_write(handle, 0, (const uint8_t *)"hello", 5, &written) == FN_OK && written == 5,
+           "submit: buffered write");
+    _check(_log->writes == writes, "submit: small write was sent, not buffered");
+
+    _request(&req, FN_OP_WRITE, handle, 5, tail, 5);
+    _check(fn_submit(&req) == FN_OK, "submit: fn_submit");
+    _check(_log->writes == writes + 1, "submit: buffer not flushed by fn_submit");
+
+    c = _wait();
+    _check(c.status == FN_OK && c.count == 5, "submit: completion");
+    _check(_log->len[handle] == 10 && memcmp(_log->data[handle], "helloworld", 10) == 0,
+           "submit: device got the bytes out of order");
+
+    fn_close(handle);
+}
+
+/* While the link is busy the buffer can't go out, so the WRITE waits */
+static void _test_submit_busy(void) {
+    static uint8_t tail[] = "def";
+    static uint8_t buf[16];
+    fn_request_t req;
+    fn_completion_t c;
+    fn_handle_t writer;
+    fn_handle_t reader;
+    uint16_t written;
+
+    fn_open(&writer, FN_METHOD_PUT, "http://test/busy", FN_OPEN_WRITE_BUFFER);
+    fn_open(&reader, FN_METHOD_GET, "http://test/read", 0);
+    fn_write(writer, 0, (const uint8_t *)"abc", 3, &written);
+
+    _request(&req, FN_OP_READ, reader, 0, buf, sizeof(buf));
+    fn_submit(&req);
+    fn_step();
+
+    _request(&req, FN_OP_WRITE, writer, 3, tail, 3);
+    _check(fn_submit(&req) == FN_ERR_BUSY, "busy: fn_submit with the link busy");
+    _check(_log->len[writer] == 0, "busy: buffer sent with the link busy");
+
+    c = _wait();
+    _check(c.status == FN_OK && c.count == sizeof(buf), "busy: read completion");
+
+    _check(fn_submit(&req) == FN_OK, "busy: fn_submit once the link is free");
+    c = _wait();
+    _check(c.status == FN_OK && c.count == 3, "busy: write completion");
+    _check(_log->len[writer] == 6 && memcmp(_log->data[writer], "abcdef", 6) == 0,
+           "busy: device got the bytes out of order");
+
+    fn_close(reader);
+    fn_close(writer);
+}
+
+/* A delayed flush that meets a busy link goes out on a later call */
+static void _test_stale_busy(void) {
+    static uint8_t buf[16];
+    fn_request_t req;
+    fn_handle_t writer;
+    fn_handle_t reader;
+    uint16_t written;
+
+    fn_set_flush_delay(1);
+    fn_open(&writer, FN_METHOD_PUT, "http://test/stale", FN_OPEN_WRITE_BUFFER);
+    fn_open(&reader, FN_METHOD_GET, "http://test/read", 0);
+    fn_write(writer, 0, (const uint8_t *)"abc", 3, &written);
+
+    _request(&req, FN_OP_READ, reader, 0, buf, sizeof(buf));
+    fn_submit(&req);
+    fn_step();
+    usleep(5000);
+
+    /* Due, but the link is busy: it stays buffered, this write with it */
+    _check(fn_write(writer, 3, (const uint8_t *)"d", 1, &written) == FN_OK, "stale: write while busy");
+    _check(_log->len[writer] == 0, "stale: buffer sent with the link busy");
+
+    _wait();
+    usleep(5000);
+
+    /* Any later call sends it; the session wasn't written off */
+    fn_write(writer, 4, (const uint8_t *)"e", 1, &written);
+    _check(_log->len[writer] == 4 && memcmp(_log->data[writer], "abcd", 4) == 0,
+           "stale: delayed flush not retried once the link was free");
+
+    fn_close(reader);
+    fn_close(writer);
+    fn_set_flush_delay(FN_FLUSH_DELAY);
+}
+
+/* A session whose buffered writes fail says so in fn_poll() */
+static void _test_poll_flush_error(void) {
+    fn_poll_t entries[FN_MAX_SESSIONS];
+    fn_handle_t failing;
+    fn_handle_t healthy;
+    uint16_t written;
+    uint16_t count;
+    uint16_t i;
+    int seen;
+
+    fn_open(&failing, FN_METHOD_PUT, "http://test/fail", FN_OPEN_WRITE_BUFFER);
+    fn_open(&healthy, FN_METHOD_GET, "http://test/read", 0);
+    fn_write(failing, 0, (const uint8_t *)"abc", 3, &written);
+
+    _check(fn_poll(entries, FN_MAX_SESSIONS, &count) == FN_OK && count == 2, "poll: fn_poll");
+    seen = 0;
+    for (i = 0; i < count; i++) {
+        if (entries[i].handle == failing) {
+            _check(entries[i].result == FN_ERR_NOT_READY, "poll: flush error not reported");
+            seen++;
+        } else if (entries[i].handle == healthy) {
+            _check(entries[i].result == FN_OK && entries[i].flags == FN_INFO_CONNECTED,
+                   "poll: other session");
+            seen++;
+        }
+    }
+    _check(seen == 2, "poll: sessions missing");
+
+    _check(fn_close(failing) == FN_ERR_NOT_READY, "poll: fn_close after the failed flush");
+    fn_close(healthy);
+}
+
+int main(void) {
+    struct termios t;
+    char name[128];
+    uint8_t result;
+    pid_t pid;
+    int master;
+    int slave;
+    int status;
+
+    _log = mmap(NULL, sizeof(device_log_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (_log == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(_log, 0, sizeof(device_log_t));
+
+    if (openpty(&master, &slave, name, NULL, NULL) != 0) {
+        perror("openpty");
+        return 1;
+    }
+    tcgetattr(master, &t);
+    cfmakeraw(&t);
+    tcsetattr(master, TCSANOW, &t);
+
+    pid = fork();
+    if (pid == 0) {
+        close(slave);
+        _device(master);
+    }
+    close(master);
+    setenv("FN_PORT", name, 1);
+
+    result = fn_init();
+    if (result != FN_OK) {
+        printf("fn_init: %s\n", fn_error_string(result));
+        kill(pid, SIGKILL);
+        return 1;
+    }
+
+    _test_submit_flushes();
+    _test_submit_busy();
+    _test_stale_busy();
+    _test_poll_flush_error();
+
+    close(slave);
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+
+    _check(_log->bad_offsets == 0, "a WRITE arrived at the wrong offset");
+    if (_failures > 0) {
+        printf("%d checks failed\n", _failures);
+        return 1;
+    }
+    printf("buffered writes: all checks passed\n");
+    return 0;
+}